@@ -0,0 +1,128 @@
+/*
+ * \brief  Text format of recorded input events
+ * \author agent
+ * \date   2026-10-16
+ *
+ * A recording consists of one event per line, led by the time in
+ * microseconds relative to the start of the recording:
+ *
+ * ! <time_us> press <keycode>
+ * ! <time_us> release <keycode>
+ * ! <time_us> motion <x> <y>
+ * ! <time_us> relative <x> <y>
+ * ! <time_us> wheel <x> <y>
+ *
+ * Other events are not recorded.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+#ifndef _INCLUDE__INPUT_RECORD__FORMAT_H_
+#define _INCLUDE__INPUT_RECORD__FORMAT_H_
+
+/* Genode includes */
+#include <input/event.h>
+#include <util/string.h>
+
+namespace Input_record {
+
+	using namespace Genode;
+
+	typedef String<64> Line;
+
+	/**
+	 * Format an event as line, return an invalid line for events that
+	 * are not recorded
+	 */
+	static inline Line line(uint64_t time_us, Input::Event const &ev)
+	{
+		Line result;
+
+		ev.handle_press([&] (Input::Keycode key, Codepoint) {
+			result = Line(time_us, " press ", (unsigned)key, "\n"); });
+
+		ev.handle_release([&] (Input::Keycode key) {
+			result = Line(time_us, " release ", (unsigned)key, "\n"); });
+
+		ev.handle_absolute_motion([&] (int x, int y) {
+			result = Line(time_us, " motion ", x, " ", y, "\n"); });
+
+		ev.handle_relative_motion([&] (int x, int y) {
+			result = Line(time_us, " relative ", x, " ", y, "\n"); });
+
+		ev.handle_wheel([&] (int x, int y) {
+			result = Line(time_us, " wheel ", x, " ", y, "\n"); });
+
+		return result;
+	}
+
+	/**
+	 * Parse a line, return false if it does not describe an event
+	 */
+	static inline bool parse(char const *s, uint64_t &time_us, Input::Event &ev)
+	{
+		auto skip_space = [&] () { while (*s == ' ' || *s == '\t') ++s; };
+
+		auto number = [&] (long &value) {
+			skip_space();
+			bool const neg = (*s == '-');
+			if (neg) ++s;
+			unsigned long v = 0;
+			size_t const n = ascii_to(s, v);
+			s += n;
+			value = neg ? -(long)v : (long)v;
+			return n > 0;
+		};
+
+		auto keyword = [&] (char const *word) {
+			skip_space();
+			size_t const len = strlen(word);
+			if (strcmp(s, word, len) != 0 || (s[len] != ' ' && s[len] != '\t'))
+				return false;
+			s += len;
+			return true;
+		};
+
+		long t = 0, a = 0, b = 0;
+		if (!number(t))
+			return false;
+		time_us = t;
+
+		if (keyword("press") && number(a)) {
+			ev = Input::Event(Input::Press { Input::Keycode(a) });
+			return true;
+		}
+		if (keyword("release") && number(a)) {
+			ev = Input::Event(Input::Release { Input::Keycode(a) });
+			return true;
+		}
+		if (keyword("motion") && number(a) && number(b)) {
+			ev = Input::Event(Input::Absolute_motion { (int)a, (int)b });
+			return true;
+		}
+		if (keyword("relative") && number(a) && number(b)) {
+			ev = Input::Event(Input::Relative_motion { (int)a, (int)b });
+			return true;
+		}
+		if (keyword("wheel") && number(a) && number(b)) {
+			ev = Input::Event(Input::Wheel { (int)a, (int)b });
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * Return true if both events describe the same input
+	 */
+	static inline bool same(Input::Event const &a, Input::Event const &b)
+	{
+		return line(0, a) == line(0, b) && line(0, a).valid();
+	}
+}
+
+#endif /* _INCLUDE__INPUT_RECORD__FORMAT_H_ */
@@ -0,0 +1,135 @@
+/*
+ * \brief   Seekable multi-lane PCG noise
+ * \author  agent
+ * \date    2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+#ifndef _BLK_SHRED__NOISE_H_
+#define _BLK_SHRED__NOISE_H_
+
+/* Genode includes */
+#include <base/stdint.h>
+
+/* PCG includes */
+#include <pcg_variants.h>
+
+namespace Blk_shred { class Noise; }
+
+
+/**
+ * Noise of 'LANES' interleaved PCG32 streams
+ *
+ * Word 'i' of the noise is the output of lane 'i % LANES' at position
+ * 'i / LANES'. The lanes differ in their increment and are advanced in
+ * lock step by loops without dependencies between lanes. The independent
+ * lanes give instruction-level parallelism and are auto-vectorized where
+ * the target allows. The 'blk_shred_noise' test measures the gain.
+ * Each lane produces exactly the sequence of 'pcg32_random_r', so the
+ * noise can be checked against the scalar generator and any position is
+ * reached in logarithmic time with 'seek'.
+ *
+ * Positions and lengths are counted in words and must be multiples of
+ * 'LANES'.
+ */
+class Blk_shred::Noise
+{
+	public:
+
+		enum { LANES = 8 };
+
+	private:
+
+		typedef Genode::uint64_t uint64_t;
+		typedef Genode::uint32_t uint32_t;
+
+		/* lane states at position zero */
+		uint64_t _initial[LANES];
+
+		uint64_t _inc[LANES];
+		uint64_t _state[LANES];
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param seed  initial state as passed to 'pcg32_srandom_r'
+		 * \param seq   sequence selector of the first lane, the following
+		 *              lanes use the subsequent sequences
+		 */
+		Noise(uint64_t seed, uint64_t seq)
+		{
+			for (unsigned l = 0; l < LANES; l++) {
+				pcg32_random_t rng;
+				pcg32_srandom_r(&rng, seed, seq + l);
+				_initial[l] = rng.state;
+				_inc[l]     = rng.inc;
+			}
+			seek(0);
+		}
+
+		/**
+		 * Clear the seed and state of all lanes
+		 */
+		void wipe()
+		{
+			for (unsigned l = 0; l < LANES; l++)
+				_initial[l] = _inc[l] = _state[l] = 0;
+		}
+
+		/**
+		 * Position the generator at word 'pos'
+		 */
+		void seek(uint64_t pos)
+		{
+			for (unsigned l = 0; l < LANES; l++)
+				_state[l] = pcg_advance_lcg_64(_initial[l], pos / LANES,
+				                               PCG_DEFAULT_MULTIPLIER_64,
+				                               _inc[l]);
+		}
+
+		/**
+		 * Return a scalar generator at the position of lane 'l'
+		 */
+		pcg32_random_t lane(unsigned l) const
+		{
+			pcg32_random_t rng;
+			rng.state = _state[l];
+			rng.inc   = _inc[l];
+			return rng;
+		}
+
+		/**
+		 * Write the next 'count' words of noise to 'dst'
+		 */
+		void fill(uint32_t *dst, Genode::size_t count)
+		{
+			uint64_t state[LANES];
+			for (unsigned l = 0; l < LANES; l++)
+				state[l] = _state[l];
+
+			for (Genode::size_t i = 0; i < count; i += LANES) {
+				for (unsigned l = 0; l < LANES; l++) {
+					uint64_t const old = state[l];
+					state[l] = old*PCG_DEFAULT_MULTIPLIER_64 + _inc[l];
+
+					/* XSH RR output function */
+					uint32_t const xs  = ((old >> 18) ^ old) >> 27;
+					uint32_t const rot = old >> 59;
+					dst[i + l] = (xs >> rot) | (xs << ((-rot) & 31));
+				}
+			}
+
+			for (unsigned l = 0; l < LANES; l++)
+				_state[l] = state[l];
+		}
+};
+
+#endif /* _BLK_SHRED__NOISE_H_ */
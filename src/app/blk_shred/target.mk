@@ -2,4 +2,7 @@ TARGET = blk_shred
 LIBS   = base jitterentropy libpcg_random
 SRC_CC = main.cc
 
+# unroll the independent noise lanes
+CC_OLEVEL = -O3
+
 CC_CXX_WARN_STRICT =
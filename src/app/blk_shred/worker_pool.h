@@ -0,0 +1,264 @@
+/*
+ * \brief   Threads that generate or check the noise of packets
+ * \author  agent
+ * \date    2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+#ifndef _BLK_SHRED__WORKER_POOL_H_
+#define _BLK_SHRED__WORKER_POOL_H_
+
+/* Genode includes */
+#include <block_session/block_session.h>
+#include <base/semaphore.h>
+#include <base/thread.h>
+#include <base/lock.h>
+
+/* local includes */
+#include "noise.h"
+
+namespace Blk_shred {
+	struct Job;
+	class Job_queue;
+	class Worker_pool;
+}
+
+
+/**
+ * Noise to generate for the content of a packet or to compare it with
+ */
+struct Blk_shred::Job
+{
+	enum Op { FILL, CHECK };
+
+	Op                       op      = FILL;
+	Block::Packet_descriptor packet  { };
+	Genode::uint32_t        *content = nullptr;
+
+	/* result of a check */
+	bool            valid    = true;
+	Block::sector_t mismatch = 0;
+
+	Job() { }
+
+	Job(Op op, Block::Packet_descriptor const &packet, Genode::uint32_t *content)
+	: op(op), packet(packet), content(content) { }
+};
+
+
+/**
+ * Bounded queue of jobs shared by threads
+ */
+class Blk_shred::Job_queue
+{
+	private:
+
+		Genode::Allocator &_alloc;
+
+		unsigned const _capacity;
+
+		Job * const _jobs;
+
+		unsigned _head  = 0;
+		unsigned _count = 0;
+
+		Genode::Lock      _lock { };
+		Genode::Semaphore _avail { };
+
+		/*
+		 * Noncopyable
+		 */
+		Job_queue(Job_queue const &);
+		Job_queue &operator = (Job_queue const &);
+
+	public:
+
+		Job_queue(Genode::Allocator &alloc, unsigned capacity)
+		:
+			_alloc(alloc), _capacity(capacity),
+			_jobs((Job *)alloc.alloc(capacity*sizeof(Job)))
+		{ }
+
+		~Job_queue() { _alloc.free(_jobs, _capacity*sizeof(Job)); }
+
+		void put(Job const &job)
+		{
+			{
+				Genode::Lock::Guard guard(_lock);
+				_jobs[(_head + _count++) % _capacity] = job;
+			}
+			_avail.up();
+		}
+
+		/**
+		 * Take the oldest job, block until one is available
+		 */
+		Job get()
+		{
+			_avail.down();
+
+			Genode::Lock::Guard guard(_lock);
+			Job const job = _jobs[_head];
+			_head = (_head + 1) % _capacity;
+			_count--;
+			return job;
+		}
+};
+
+
+/**
+ * Threads that fill packets with the noise of their blocks or check
+ * packets against it
+ *
+ * Every worker owns a copy of the noise generator and seeks it to the
+ * first block of a packet, so the noise of a block only depends on its
+ * number and not on the worker or the order of the packets. The workers
+ * are spread over the CPUs of the component.
+ */
+class Blk_shred::Worker_pool
+{
+	private:
+
+		enum { STACK_SIZE = 16*1024*sizeof(long) };
+
+		struct Worker : Genode::Thread
+		{
+			Worker_pool &_pool;
+			Noise        _noise;
+
+			/* expected content of one block */
+			Genode::uint32_t * const _block;
+
+			Worker(Genode::Env &env, Worker_pool &pool, Noise const &noise,
+			       Genode::Affinity::Location location)
+			:
+				Genode::Thread(env, "worker", STACK_SIZE, location,
+				               Weight(), env.cpu()),
+				_pool(pool), _noise(noise),
+				_block((Genode::uint32_t *)pool._alloc.alloc(pool._block_size))
+			{ }
+
+			~Worker()
+			{
+				_noise.wipe();
+				_pool._alloc.free(_block, _pool._block_size);
+			}
+
+			void _check(Job &job)
+			{
+				Genode::size_t const words = _pool._words_per_block;
+
+				for (Genode::size_t i = 0; i < job.packet.block_count(); i++) {
+					_noise.fill(_block, words);
+					if (Genode::memcmp(job.content + i*words, _block, _pool._block_size)) {
+						job.valid    = false;
+						job.mismatch = job.packet.block_number() + i;
+						return;
+					}
+				}
+			}
+
+			void entry() override
+			{
+				for (;;) {
+					Job job = _pool._pending.get();
+					if (!job.content)
+						return;
+
+					_noise.seek(job.packet.block_number()*_pool._words_per_block);
+
+					switch (job.op) {
+					case Job::FILL:
+						_noise.fill(job.content,
+						            job.packet.block_count()*_pool._words_per_block);
+						break;
+					case Job::CHECK:
+						_check(job);
+						break;
+					}
+
+					_pool._finished.put(job);
+				}
+			}
+		};
+
+		Genode::Allocator &_alloc;
+
+		Genode::size_t const _block_size;
+		Genode::size_t const _words_per_block;
+
+		unsigned const _count;
+
+		Job_queue _pending;
+		Job_queue _finished;
+
+		Worker **_workers;
+
+		/*
+		 * Noncopyable
+		 */
+		Worker_pool(Worker_pool const &);
+		Worker_pool &operator = (Worker_pool const &);
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param count  number of worker threads
+		 * \param slots  maximum number of jobs in the pool
+		 */
+		Worker_pool(Genode::Env &env, Genode::Allocator &alloc,
+		            Noise const &noise, Genode::size_t block_size,
+		            unsigned count, unsigned slots)
+		:
+			_alloc(alloc),
+			_block_size(block_size),
+			_words_per_block(block_size / sizeof(Genode::uint32_t)),
+			_count(Genode::max(1U, count)),
+			_pending (alloc, slots + _count),
+			_finished(alloc, slots),
+			_workers((Worker **)alloc.alloc(_count*sizeof(Worker *)))
+		{
+			Genode::Affinity::Space const space = env.cpu().affinity_space();
+
+			for (unsigned i = 0; i < _count; i++) {
+				_workers[i] = new (alloc)
+					Worker(env, *this, noise, space.location_of_index(i + 1));
+				_workers[i]->start();
+			}
+		}
+
+		~Worker_pool()
+		{
+			for (unsigned i = 0; i < _count; i++)
+				_pending.put(Job());
+
+			for (unsigned i = 0; i < _count; i++) {
+				_workers[i]->join();
+				destroy(_alloc, _workers[i]);
+			}
+
+			_alloc.free(_workers, _count*sizeof(Worker *));
+		}
+
+		unsigned count() const { return _count; }
+
+		/**
+		 * Queue a packet to be filled or checked
+		 */
+		void submit(Job const &job) { _pending.put(job); }
+
+		/**
+		 * Return a processed packet, block until one is available
+		 */
+		Job finished() { return _finished.get(); }
+};
+
+#endif /* _BLK_SHRED__WORKER_POOL_H_ */
@@ -31,12 +31,18 @@
 #include <audio_out_session/audio_out_session.h>
 #include <timer_session/connection.h>
 #include <base/attached_rom_dataspace.h>
+#include <base/heap.h>
 #include <libc/component.h>
 #include <base/log.h>
 
 /* ChucK includes */
 #include "chuck.h"
-#include "chuck_audio.h"
+#include "util_math.h"
+
+/* local includes */
+#include "genode_audio.h"
+#include "programs.h"
+#include "offline.h"
 
 using namespace Genode;
 
@@ -48,42 +54,124 @@ using namespace Genode;
 ChucK * the_chuck;
 
 
-//-----------------------------------------------------------------------------
-// name: cb()
-// desc: audio callback
-//-----------------------------------------------------------------------------
-void cb( t_CKSAMPLE * in, t_CKSAMPLE * out, t_CKUINT numFrames,
-        t_CKUINT numInChans, t_CKUINT numOutChans, void * data )
+struct Main : Chuck_genode::Audio_output::Render
 {
-    // TODO: check channel numbers
-    
-    // call up to ChucK
-    the_chuck->run( in, out, numFrames );
-}
-
+	enum { BUFFER_SIZE_DEFAULT = 256, QUEUED_PACKETS_DEFAULT = 4 };
 
-struct Main
-{
 	Libc::Env &env;
 
+	Genode::Heap heap { env.ram(), env.rm() };
+
 	t_CKBOOL g_enable_realtime_audio = TRUE;
 	t_CKBOOL enable_system_cmd = FALSE;
 
+	Constructible<Chuck_genode::Audio_output> audio_output { };
+
+	Constructible<Chuck_genode::Programs> programs { };
+
 	Main(Libc::Env &env): env(env) { };
 
+	/**
+	 * Audio_output::Render interface, called on Audio_out progress
+	 */
+	void render(float *out, unsigned frames) override
+	{
+		Libc::with_libc([&] () {
+			the_chuck->run( nullptr, out, frames ); });
+	}
+
+	/**
+	 * Render each program given as '<arg>' into its own WAV file
+	 */
+	template <typename CREATE_VM>
+	void render_offline(CREATE_VM const &create_vm, t_CKINT srate,
+	                    t_CKINT buffer_size, t_CKINT channels,
+	                    t_CKUINT seconds, std::string const &dir, bool report)
+	{
+		Timer::Connection timer { env };
+
+		Chuck_genode::Offline_render renderer { heap, timer,
+		                                        (unsigned)buffer_size,
+		                                        (unsigned)channels };
+
+		typedef Chuck_genode::Offline_render::Result Result;
+		typedef String<256> Patch;
+
+		struct Rendered { Patch patch; Result result; };
+		std::vector<Rendered> rendered;
+
+		auto const render_fn = [&] (Xml_node const &node) {
+			Patch const patch = node.attribute_value( "value", Patch() );
+			char const *arg = patch.string();
+			if( arg[0] == '-' || arg[0] == '+' )
+				return;
+
+			// output file is named after the program
+			std::string name = arg;
+			std::string::size_type const slash = name.rfind( '/' );
+			if( slash != std::string::npos ) name = name.substr( slash + 1 );
+			std::string::size_type const dot = name.rfind( '.' );
+			if( dot != std::string::npos ) name = name.substr( 0, dot );
+			std::string const out = dir + ( dir.size() && dir[dir.size()-1] == '/' ? "" : "/" )
+			                      + name + ".wav";
+
+			the_chuck = create_vm( FALSE );
+
+			if( the_chuck->compileFile( arg, "" ) )
+			{
+				the_chuck->start();
+
+				try {
+					Chuck_genode::Wav_file wav( out.c_str(), channels, srate );
+					Result const r = renderer.render( *the_chuck, wav, seconds*srate );
+					unsigned long const factor = r.realtime_percent( srate );
+
+					log( "rendered ", arg, " to ", out.c_str(), ": ",
+					     r.frames*1000/srate, " ms in ", r.elapsed_us/1000, " ms, "
+					     "realtime factor ", factor/100, ".", factor%100/10, factor%10 );
+
+					rendered.push_back( Rendered { patch, r } );
+				}
+				catch( Chuck_genode::Wav_file::Open_failed ) {
+					error( "could not create ", out.c_str() ); }
+			}
+			else
+			{
+				error( "failed to compile ", arg );
+			}
+
+			delete the_chuck;
+			the_chuck = nullptr;
+		};
+
+		env.config([&] (Xml_node const &config) {
+			config.for_each_sub_node( "arg", render_fn ); });
+
+		if( !report )
+			return;
+
+		Reporter reporter { env, "render" };
+		reporter.enabled( true );
+		Reporter::Xml_generator xml( reporter, [&] () {
+			for( Rendered const &r : rendered )
+				xml.node( "program", [&] () {
+					xml.attribute( "path",          r.patch );
+					xml.attribute( "frames",        r.result.frames );
+					xml.attribute( "elapsed_ms",    r.result.elapsed_us/1000 );
+					xml.attribute( "realtime_percent", r.result.realtime_percent( srate ) );
+				});
+		});
+	}
+
 	void go()
 	{
 		t_CKBOOL vm_halt = TRUE;
-		t_CKINT srate = SAMPLE_RATE_DEFAULT;
-		t_CKBOOL force_srate = FALSE; // added 1.3.1.2
+		t_CKINT srate = Audio_out::SAMPLE_RATE;
 		t_CKINT buffer_size = BUFFER_SIZE_DEFAULT;
-		t_CKINT num_buffers = NUM_BUFFERS_DEFAULT;
-		t_CKINT dac = 0;
-		t_CKINT adc = 0;
-		std::string dac_name = ""; // added 1.3.0.0
-		std::string adc_name = ""; // added 1.3.0.0
-		t_CKINT dac_chans = 0;
-		t_CKINT adc_chans = 2;
+		t_CKINT num_buffers = QUEUED_PACKETS_DEFAULT;
+		t_CKINT dac_chans = Chuck_genode::Audio_output::NUM_CHANNELS;
+		t_CKINT adc_chans = 0;
+		t_CKBOOL report_xruns = FALSE;
 		t_CKBOOL dump = FALSE;
 		t_CKBOOL auto_depend = FALSE;
 		t_CKBOOL block = FALSE;
@@ -92,12 +180,19 @@ struct Main
 		t_CKBOOL load_hid = FALSE;
 		t_CKBOOL enable_server = TRUE;
 		t_CKBOOL do_watchdog = TRUE;
-		t_CKINT  adaptive_size = 0;
+		t_CKINT  adaptive_size = -1; // -1 == buffer size
 		t_CKINT  log_level = CK_LOG_CORE;
 		t_CKINT  deprecate_level = 1; // 1 == warn
 		t_CKINT  chugin_load = 1; // 1 == auto (variable added 1.3.0.0)
 		// whether to make this new VM the one that receives OTF commands
 		t_CKBOOL update_otf_vm = TRUE;
+		t_CKBOOL otf_enable = FALSE;
+		t_CKINT  otf_port = 8888;
+		t_CKBOOL watch_programs = FALSE;
+		t_CKBOOL offline = FALSE;
+		t_CKBOOL report_render = FALSE;
+		t_CKUINT render_seconds = 60;
+		std::string render_dir = "/";
 		string   filename = "";
 		vector<string> args;
 
@@ -144,6 +239,45 @@ struct Main
 
 		//------------------------- COMMAND LINE ARGUMENTS -----------------------------
 
+		env.config([&] (Xml_node const &config) {
+			srate           = config.attribute_value( "sample_rate",     (long)srate );
+			buffer_size     = config.attribute_value( "buffer_size",     (long)buffer_size );
+			num_buffers     = config.attribute_value( "num_buffers",     (long)num_buffers );
+			adaptive_size   = config.attribute_value( "adaptive_size",   (long)adaptive_size );
+			log_level       = config.attribute_value( "log_level",       (long)log_level );
+			deprecate_level = config.attribute_value( "deprecate_level", (long)deprecate_level );
+			dump            = config.attribute_value( "dump",            (bool)dump );
+			otf_enable      = config.attribute_value( "otf",             (bool)otf_enable );
+			otf_port        = config.attribute_value( "otf_port",        (long)otf_port );
+
+			// a VM fed by the programs ROM must survive the removal of all shreds
+			watch_programs  = config.has_sub_node( "programs" );
+			vm_halt         = config.attribute_value( "halt", watch_programs ? false : true );
+
+			if( config.has_sub_node( "report" ) )
+			{
+				Xml_node const report = config.sub_node( "report" );
+				report_xruns  = report.attribute_value( "xruns",  false );
+				report_render = report.attribute_value( "render", false );
+			}
+
+			// render to WAV files instead of Audio_out
+			offline = config.has_sub_node( "render" );
+			if( offline )
+			{
+				Xml_node const render = config.sub_node( "render" );
+				render_seconds = render.attribute_value( "seconds", (unsigned long)render_seconds );
+				render_dir     = render.attribute_value( "dir", String<256>( "/" ) ).string();
+			}
+		});
+
+		// the VM runs at the rate of the Audio_out session
+		if( !offline && srate != Audio_out::SAMPLE_RATE )
+		{
+			warning( "sample rate ", srate, " not supported, using ", (unsigned)Audio_out::SAMPLE_RATE );
+			srate = Audio_out::SAMPLE_RATE;
+		}
+
 		// log level
 		EM_setlog( log_level );
 
@@ -164,65 +298,49 @@ struct Main
 			exit( 1 );
 		}
 
-		// find dac_name if appropriate (added 1.3.0.0)
-		if( dac_name.size() > 0 )
+		//------------------------- VIRTUAL MACHINE SETUP -----------------------------
+		auto const create_vm = [&] ( t_CKBOOL realtime )
 		{
-			// check with RtAudio
-			int dev = ChuckAudio::device_named( dac_name, TRUE, FALSE );
-			if( dev >= 0 )
-			{
-				dac = dev;
-			}
-			else
+			// instantiate ChucK
+			ChucK * chuck = new ChucK();
+
+			// set params
+			chuck->setParam( CHUCK_PARAM_SAMPLE_RATE, srate );
+			chuck->setParam( CHUCK_PARAM_INPUT_CHANNELS, adc_chans );
+			chuck->setParam( CHUCK_PARAM_OUTPUT_CHANNELS, dac_chans );
+			chuck->setParam( CHUCK_PARAM_VM_ADAPTIVE, adaptive_size );
+			chuck->setParam( CHUCK_PARAM_VM_HALT, (t_CKINT)(vm_halt || !realtime) );
+			chuck->setParam( CHUCK_PARAM_OTF_ENABLE, (t_CKINT)(otf_enable && realtime) );
+			chuck->setParam( CHUCK_PARAM_OTF_PORT, otf_port );
+			chuck->setParam( CHUCK_PARAM_DUMP_INSTRUCTIONS, (t_CKINT)dump );
+			chuck->setParam( CHUCK_PARAM_AUTO_DEPEND, (t_CKINT)auto_depend );
+			chuck->setParam( CHUCK_PARAM_DEPRECATE_LEVEL, deprecate_level );
+			chuck->setParam( CHUCK_PARAM_USER_CHUGINS, named_dls );
+			chuck->setParam( CHUCK_PARAM_USER_CHUGIN_DIRECTORIES, dl_search_path );
+			// set hint, so internally can advise things like async data writes etc.
+			chuck->setParam( CHUCK_PARAM_HINT_IS_REALTIME_AUDIO, realtime );
+			chuck->setLogLevel( log_level );
+
+			// initialize
+			if( !chuck->init() )
 			{
-				CK_FPRINTF_STDERR( "[chuck]: unable to find dac '%s'...\n", dac_name.c_str() );
+				CK_FPRINTF_STDERR( "[chuck]: failed to initialize...\n" );
 				exit( 1 );
 			}
-		}
 
-		// find adc_name if appropriate (added 1.3.0.0)
-		if( adc_name.size() > 0 )
-		{
-			// check with RtAudio
-			int dev = ChuckAudio::device_named( adc_name, FALSE, TRUE );
-			if( dev >= 0 )
-			{
-				adc = dev;
-			}
-			else
-			{
-				CK_FPRINTF_STDERR( "[chuck]: unable to find adc '%s'...\n", adc_name.c_str() );
-				exit( 1 );
-			}
-		}
+			return chuck;
+		};
 
-		//------------------------- VIRTUAL MACHINE SETUP -----------------------------
-		// instantiate ChucK
-		the_chuck = new ChucK();
-
-		// set params
-		the_chuck->setParam( CHUCK_PARAM_SAMPLE_RATE, Audio_out::SAMPLE_RATE );
-		the_chuck->setParam( CHUCK_PARAM_INPUT_CHANNELS, 0 );
-		the_chuck->setParam( CHUCK_PARAM_OUTPUT_CHANNELS, 2 );
-		the_chuck->setParam( CHUCK_PARAM_VM_ADAPTIVE, adaptive_size );
-		the_chuck->setParam( CHUCK_PARAM_VM_HALT, (t_CKINT)(vm_halt) );
-		the_chuck->setParam( CHUCK_PARAM_OTF_ENABLE, (t_CKINT)FALSE );
-		the_chuck->setParam( CHUCK_PARAM_DUMP_INSTRUCTIONS, (t_CKINT)dump );
-		the_chuck->setParam( CHUCK_PARAM_AUTO_DEPEND, (t_CKINT)auto_depend );
-		the_chuck->setParam( CHUCK_PARAM_DEPRECATE_LEVEL, deprecate_level );
-		the_chuck->setParam( CHUCK_PARAM_USER_CHUGINS, named_dls );
-		the_chuck->setParam( CHUCK_PARAM_USER_CHUGIN_DIRECTORIES, dl_search_path );
-		// set hint, so internally can advise things like async data writes etc.
-		the_chuck->setParam( CHUCK_PARAM_HINT_IS_REALTIME_AUDIO, TRUE );
-		the_chuck->setLogLevel( log_level );
-
-		// initialize
-		if( !the_chuck->init() )
+		//------------------------- OFFLINE RENDERING ---------------------------------
+		if( offline )
 		{
-			CK_FPRINTF_STDERR( "[chuck]: failed to initialize...\n" );
-			exit( 1 );
+			render_offline( create_vm, srate, buffer_size, dac_chans,
+			                render_seconds, render_dir, report_render );
+			exit( 0 );
 		}
 
+		the_chuck = create_vm( TRUE );
+
 		//--------------------------- AUDIO I/O SETUP ---------------------------------
 		// log
 		EM_log( CK_LOG_SYSTEM, "initializing audio I/O..." );
@@ -230,22 +348,9 @@ struct Main
 		EM_pushlog();
 		// log
 
-		// initialize audio system
-		// TODO: refactor initialize() to take in the dac and adc nums
-		ChuckAudio::m_adc_n = adc;
-		ChuckAudio::m_dac_n = dac;
-		t_CKBOOL retval = ChuckAudio::initialize( adc_chans, dac_chans,
-			srate, buffer_size, num_buffers, cb, (void *)the_chuck, force_srate );
-		// check
-		if( !retval )
-		{
-			EM_log( CK_LOG_SYSTEM,
-				   "cannot initialize audio device (use --silent/-s for non-realtime)" );
-			// pop
-			EM_poplog();
-			// done
-			exit( 1 );
-		}
+		// initialize audio system, the VM is run from the Audio_out progress signal
+		audio_output.construct( env, heap, *this, buffer_size, num_buffers,
+		                        report_xruns );
 
 		// log
 		EM_log( CK_LOG_SYSTEM, "real-time audio: %s", g_enable_realtime_audio ? "YES" : "NO" );
@@ -255,7 +360,6 @@ struct Main
 		if( g_enable_realtime_audio )
 		{
 			EM_log( CK_LOG_SYSTEM, "num buffers: %ld", num_buffers );
-			EM_log( CK_LOG_SYSTEM, "adc: %ld dac: %d", adc, dac );
 			EM_log( CK_LOG_SYSTEM, "adaptive block processing: %ld", adaptive_size > 1 ? adaptive_size : 0 );
 		}
 		EM_log( CK_LOG_SYSTEM, "channels in: %ld out: %ld", adc_chans, dac_chans );
@@ -316,20 +420,17 @@ struct Main
 		// start it!
 		the_chuck->start();
 
+		// follow the programs ROM
+		if( watch_programs )
+			programs.construct( env, heap, *the_chuck );
+
 		// log
 		EM_log( CK_LOG_SEVERE, "virtual machine running..." );
 		// pop indent
 		EM_poplog();
 
-		// silent mode buffers
-		SAMPLE * input = new SAMPLE[buffer_size*adc_chans];
-		SAMPLE * output = new SAMPLE[buffer_size*dac_chans];
-		// zero out
-		Genode::memset( input, 0, sizeof(SAMPLE)*buffer_size*adc_chans );
-		Genode::memset( output, 0, sizeof(SAMPLE)*buffer_size*dac_chans );
-
 		// start audio
-		ChuckAudio::start();
+		audio_output->start();
 
 		// return to entrypoint
 	}
@@ -338,8 +439,6 @@ struct Main
 
 void Libc::Component::construct(Libc::Env &env)
 {
-	init_rtaudio(env);
-
 	static Main main(env);
 
 	Libc::with_libc([&] () { main.go(); });
@@ -0,0 +1,330 @@
+/*
+ * \brief  Audio_out backend of ChucK
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _CHUCK__GENODE_AUDIO_H_
+#define _CHUCK__GENODE_AUDIO_H_
+
+/* Genode includes */
+#include <audio_out_session/connection.h>
+#include <os/reporter.h>
+#include <base/allocator.h>
+
+namespace Chuck_genode {
+
+	using namespace Genode;
+
+	template <typename> class Spsc_ring;
+	class Audio_output;
+}
+
+
+/**
+ * Lock-free ring of samples for one producer and one consumer
+ *
+ * The capacity is a power of two so that the free-running positions may
+ * wrap around. Each position is only written by one side and published
+ * with release semantics after the samples were copied.
+ */
+template <typename T>
+class Chuck_genode::Spsc_ring
+{
+	private:
+
+		Allocator    &_alloc;
+		size_t const  _capacity;
+		size_t const  _mask = _capacity - 1;
+		T     * const _data;
+
+		size_t _head = 0; /* written by the producer */
+		size_t _tail = 0; /* written by the consumer */
+
+		static size_t _pow2(size_t n)
+		{
+			size_t p = 1;
+			while (p < n) p <<= 1;
+			return p;
+		}
+
+		static size_t _load(size_t const &pos) {
+			return __atomic_load_n(&pos, __ATOMIC_ACQUIRE); }
+
+		static void _store(size_t &pos, size_t v) {
+			__atomic_store_n(&pos, v, __ATOMIC_RELEASE); }
+
+		/*
+		 * Noncopyable
+		 */
+		Spsc_ring(Spsc_ring const &);
+		Spsc_ring &operator = (Spsc_ring const &);
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param capacity  minimal number of elements, rounded up to the
+		 *                  next power of two
+		 */
+		Spsc_ring(Allocator &alloc, size_t capacity)
+		:
+			_alloc(alloc),
+			_capacity(_pow2(capacity)),
+			_data((T *)alloc.alloc(_capacity*sizeof(T)))
+		{ }
+
+		~Spsc_ring() { _alloc.free(_data, _capacity*sizeof(T)); }
+
+		size_t read_avail()  const { return _load(_head) - _load(_tail); }
+		size_t write_avail() const { return _capacity - read_avail(); }
+
+		/**
+		 * Append elements, return number of elements written
+		 */
+		size_t write(T const *src, size_t n)
+		{
+			size_t const head = _head;
+			n = min(n, _capacity - (head - _load(_tail)));
+
+			for (size_t i = 0; i < n; i++)
+				_data[(head + i) & _mask] = src[i];
+
+			_store(_head, head + n);
+			return n;
+		}
+
+		/**
+		 * Remove elements, return number of elements read
+		 */
+		size_t read(T *dst, size_t n)
+		{
+			size_t const tail = _tail;
+			n = min(n, _load(_head) - tail);
+
+			for (size_t i = 0; i < n; i++)
+				dst[i] = _data[(tail + i) & _mask];
+
+			_store(_tail, tail + n);
+			return n;
+		}
+};
+
+
+/**
+ * Stereo Audio_out backend driven by the progress signal
+ *
+ * On every progress signal, the VM is run in blocks of 'buffer_size'
+ * frames until the ring holds enough samples for the next packet, and
+ * packets are submitted until 'queued_packets' are pending. ChucK's block
+ * size is thereby independent from the Audio_out period.
+ */
+class Chuck_genode::Audio_output
+{
+	public:
+
+		enum { LEFT, RIGHT, NUM_CHANNELS };
+
+		/**
+		 * Interface of the sample producer
+		 */
+		struct Render
+		{
+			/**
+			 * Render interleaved stereo frames
+			 */
+			virtual void render(float *out, unsigned frames) = 0;
+		};
+
+	private:
+
+		Render &_render;
+
+		Audio_out::Connection  _left;
+		Audio_out::Connection  _right;
+		Audio_out::Connection *_out[NUM_CHANNELS];
+
+		Audio_out::Packet *_alloc_position = nullptr;
+
+		unsigned const _buffer_size;
+		unsigned const _queued_packets;
+
+		Spsc_ring<float> _ring;
+
+		float * const _block;
+
+		Allocator &_alloc;
+
+		Signal_handler<Audio_output> _progress_handler;
+
+		/* statistics */
+		Reporter      _reporter;
+		unsigned long _underruns          = 0;
+		unsigned long _reported_underruns = 0;
+		unsigned long _packets            = 0;
+		unsigned      _report_countdown   = 0;
+
+		template <typename FUNC>
+		void _for_each_channel(FUNC const &func) {
+			for (int i = 0; i < NUM_CHANNELS; i++) func(i); }
+
+		/*
+		 * Noncopyable
+		 */
+		Audio_output(Audio_output const &);
+		Audio_output &operator = (Audio_output const &);
+
+		unsigned _queued()
+		{
+			if (_alloc_position == nullptr)
+				return 0;
+
+			unsigned const packet_pos = _out[LEFT]->stream()->packet_position(_alloc_position);
+			unsigned const play_pos   = _out[LEFT]->stream()->pos();
+
+			return packet_pos < play_pos
+			     ? (Audio_out::QUEUE_SIZE + packet_pos) - play_pos
+			     : packet_pos - play_pos;
+		}
+
+		void _submit_packet()
+		{
+			enum { STEREO_PERIOD = Audio_out::PERIOD*NUM_CHANNELS };
+
+			while (_ring.read_avail() < STEREO_PERIOD) {
+				_render.render(_block, _buffer_size);
+				_ring.write(_block, _buffer_size*NUM_CHANNELS);
+			}
+
+			Audio_out::Packet *p[NUM_CHANNELS];
+
+			p[LEFT] = _out[LEFT]->stream()->next(_alloc_position);
+
+			unsigned const ppos = _out[LEFT]->stream()->packet_position(p[LEFT]);
+			p[RIGHT]            = _out[RIGHT]->stream()->get(ppos);
+
+			float tmp[STEREO_PERIOD];
+			_ring.read(tmp, STEREO_PERIOD);
+
+			float *left_content  = p[LEFT]->content();
+			float *right_content = p[RIGHT]->content();
+
+			for (int i = 0; i < Audio_out::PERIOD; i++) {
+				left_content[i]  = tmp[i*NUM_CHANNELS + LEFT];
+				right_content[i] = tmp[i*NUM_CHANNELS + RIGHT];
+			}
+
+			_for_each_channel([&] (int const i) { _out[i]->submit(p[i]); });
+
+			_alloc_position = p[LEFT];
+			_packets++;
+		}
+
+		void _report()
+		{
+			if (!_reporter.enabled() || _underruns == _reported_underruns)
+				return;
+
+			_reported_underruns = _underruns;
+
+			Reporter::Xml_generator xml(_reporter, [&] () {
+				xml.attribute("underruns",   _underruns);
+				xml.attribute("packets",     _packets);
+				xml.attribute("buffer_size", _buffer_size);
+			});
+		}
+
+		void _handle_progress()
+		{
+			/*
+			 * The stream ran dry if no packet is left, restart behind the
+			 * current play position
+			 */
+			if (_alloc_position && _queued() == 0) {
+				_underruns++;
+				_alloc_position = nullptr;
+			}
+
+			if (_alloc_position == nullptr)
+				_alloc_position = _out[LEFT]->stream()->next();
+
+			fill();
+
+			/* check for new xruns about once a second */
+			if (_report_countdown-- == 0) {
+				_report_countdown = Audio_out::SAMPLE_RATE / Audio_out::PERIOD;
+				_report();
+			}
+		}
+
+	public:
+
+		/**
+		 * Constructor
+		 *
+		 * \param buffer_size     frames rendered per VM invocation
+		 * \param queued_packets  number of packets kept in the stream
+		 * \param report          report xrun statistics as "xruns"
+		 */
+		Audio_output(Env &env, Allocator &alloc, Render &render,
+		             unsigned buffer_size, unsigned queued_packets,
+		             bool report)
+		:
+			_render(render),
+			_left (env, "left",  true,  true),
+			_right(env, "right", false, false),
+			_buffer_size(max(1U, buffer_size)),
+			_queued_packets(max(2U, min(queued_packets,
+			                            (unsigned)Audio_out::QUEUE_SIZE/2))),
+			_ring(alloc, (_buffer_size + Audio_out::PERIOD)*NUM_CHANNELS),
+			_block((float *)alloc.alloc(_buffer_size*NUM_CHANNELS*sizeof(float))),
+			_alloc(alloc),
+			_progress_handler(env.ep(), *this, &Audio_output::_handle_progress),
+			_reporter(env, "xruns")
+		{
+			_out[LEFT]  = &_left;
+			_out[RIGHT] = &_right;
+
+			/* all channels are synced to the left one */
+			_left.progress_sigh(_progress_handler);
+
+			_reporter.enabled(report);
+		}
+
+		~Audio_output() {
+			_alloc.free(_block, _buffer_size*NUM_CHANNELS*sizeof(float)); }
+
+		/**
+		 * Top up the stream to the configured number of queued packets
+		 */
+		void fill()
+		{
+			if (_alloc_position == nullptr)
+				_alloc_position = _out[LEFT]->stream()->next();
+
+			while (_queued() < _queued_packets)
+				_submit_packet();
+		}
+
+		void start()
+		{
+			fill();
+			_for_each_channel([&] (int const i) { _out[i]->start(); });
+		}
+
+		void stop()
+		{
+			_for_each_channel([&] (int const i) { _out[i]->stop(); });
+			_alloc_position = nullptr;
+		}
+};
+
+#endif /* _CHUCK__GENODE_AUDIO_H_ */
@@ -0,0 +1,203 @@
+/*
+ * \brief  Faster-than-realtime rendering of ChucK programs to WAV files
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _CHUCK__OFFLINE_H_
+#define _CHUCK__OFFLINE_H_
+
+/* Genode includes */
+#include <timer_session/connection.h>
+#include <base/allocator.h>
+#include <base/log.h>
+
+/* libc includes */
+#include <stdio.h>
+
+/* ChucK includes */
+#include "chuck.h"
+
+namespace Chuck_genode {
+
+	using namespace Genode;
+
+	class Wav_file;
+	class Offline_render;
+}
+
+
+/**
+ * 16-bit PCM WAV file written through the libc
+ *
+ * The sizes within the header are fixed up when the file is closed.
+ */
+class Chuck_genode::Wav_file
+{
+	private:
+
+		FILE * const   _file;
+		unsigned const _channels;
+		unsigned const _sample_rate;
+		unsigned long  _frames = 0;
+
+		/*
+		 * Noncopyable
+		 */
+		Wav_file(Wav_file const &);
+		Wav_file &operator = (Wav_file const &);
+
+		void _u16(Genode::uint16_t v)
+		{
+			unsigned char const b[2] = { (unsigned char)v, (unsigned char)(v >> 8) };
+			fwrite(b, 1, sizeof(b), _file);
+		}
+
+		void _u32(Genode::uint32_t v)
+		{
+			unsigned char const b[4] = {
+				(unsigned char)v,         (unsigned char)(v >> 8),
+				(unsigned char)(v >> 16), (unsigned char)(v >> 24) };
+			fwrite(b, 1, sizeof(b), _file);
+		}
+
+		void _header()
+		{
+			Genode::uint32_t const data_size = _frames*_channels*2;
+
+			fwrite("RIFF", 1, 4, _file); _u32(36 + data_size);
+			fwrite("WAVE", 1, 4, _file);
+			fwrite("fmt ", 1, 4, _file); _u32(16);
+			_u16(1);                             /* PCM */
+			_u16(_channels);
+			_u32(_sample_rate);
+			_u32(_sample_rate*_channels*2);      /* byte rate */
+			_u16(_channels*2);                   /* block align */
+			_u16(16);                            /* bits per sample */
+			fwrite("data", 1, 4, _file); _u32(data_size);
+		}
+
+	public:
+
+		struct Open_failed : Exception { };
+
+		Wav_file(char const *path, unsigned channels, unsigned sample_rate)
+		:
+			_file(fopen(path, "w")), _channels(channels), _sample_rate(sample_rate)
+		{
+			if (!_file) throw Open_failed();
+			_header();
+		}
+
+		~Wav_file()
+		{
+			fseek(_file, 0, SEEK_SET);
+			_header();
+			fclose(_file);
+		}
+
+		/**
+		 * Append interleaved frames
+		 */
+		void write(float const *samples, unsigned frames)
+		{
+			enum { CHUNK = 1024 };
+			Genode::int16_t buf[CHUNK];
+
+			unsigned long const count = (unsigned long)frames*_channels;
+			for (unsigned long off = 0; off < count; off += CHUNK) {
+				unsigned const n = min((unsigned long)CHUNK, count - off);
+				for (unsigned i = 0; i < n; i++) {
+					float v = samples[off + i];
+					if (v >  1.0f) v =  1.0f;
+					if (v < -1.0f) v = -1.0f;
+					buf[i] = (Genode::int16_t)(v*32767.0f);
+				}
+				fwrite(buf, sizeof(Genode::int16_t), n, _file);
+			}
+			_frames += frames;
+		}
+
+		unsigned long frames() const { return _frames; }
+};
+
+
+/**
+ * Render the VM in a tight loop until all shreds finished or the
+ * maximum duration is reached
+ */
+class Chuck_genode::Offline_render
+{
+	public:
+
+		struct Result
+		{
+			unsigned long    frames;
+			Genode::uint64_t elapsed_us;
+
+			/**
+			 * Return ratio of rendered audio time to wall-clock time in
+			 * percent
+			 */
+			unsigned long realtime_percent(unsigned sample_rate) const
+			{
+				Genode::uint64_t const audio_us = (Genode::uint64_t)frames*1000000 / sample_rate;
+				return elapsed_us ? (unsigned long)(audio_us*100 / elapsed_us) : 0;
+			}
+		};
+
+	private:
+
+		Allocator         &_alloc;
+		Timer::Connection &_timer;
+
+		unsigned const _buffer_size;
+		unsigned const _channels;
+
+		Genode::uint64_t _now_us() { return _timer.curr_time().trunc_to_plain_us().value; }
+
+		/*
+		 * Noncopyable
+		 */
+		Offline_render(Offline_render const &);
+		Offline_render &operator = (Offline_render const &);
+
+	public:
+
+		Offline_render(Allocator &alloc, Timer::Connection &timer,
+		               unsigned buffer_size, unsigned channels)
+		:
+			_alloc(alloc), _timer(timer),
+			_buffer_size(max(1U, buffer_size)), _channels(channels)
+		{ }
+
+		Result render(ChucK &chuck, Wav_file &wav, unsigned long max_frames)
+		{
+			size_t const size = _buffer_size*_channels*sizeof(float);
+			float * const block = (float *)_alloc.alloc(size);
+
+			Genode::uint64_t const start_us = _now_us();
+
+			unsigned long frames = 0;
+			while (frames < max_frames && chuck.vm()->running()) {
+				unsigned const n = min((unsigned long)_buffer_size, max_frames - frames);
+				chuck.run(nullptr, block, n);
+				wav.write(block, n);
+				frames += n;
+			}
+
+			Result const result { frames, _now_us() - start_us };
+
+			_alloc.free(block, size);
+			return result;
+		}
+};
+
+#endif /* _CHUCK__OFFLINE_H_ */
@@ -0,0 +1,204 @@
+/*
+ * \brief  Live compilation of ChucK programs supplied by a ROM
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _CHUCK__PROGRAMS_H_
+#define _CHUCK__PROGRAMS_H_
+
+/* Genode includes */
+#include <base/attached_rom_dataspace.h>
+#include <libc/component.h>
+#include <util/list.h>
+#include <base/log.h>
+
+/* ChucK includes */
+#include "chuck.h"
+
+namespace Chuck_genode {
+
+	using namespace Genode;
+
+	class Programs;
+}
+
+
+/**
+ * Set of shreds that follows the "programs" ROM
+ *
+ * Each '<program>' node names a shred that is either compiled from the
+ * file at 'path' or from the content of the node. A program is sporked
+ * when it appears in the ROM, replaced when its node changes, and removed
+ * when its node disappears, while the virtual machine keeps running.
+ * Programs are compiled on the entrypoint, which also runs the virtual
+ * machine, so compilation never races with the audio processing.
+ */
+class Chuck_genode::Programs
+{
+	private:
+
+		typedef String<64>  Name;
+		typedef String<256> Path;
+		typedef String<256> Args;
+
+		struct Program : List<Program>::Element
+		{
+			Name const    name;
+			unsigned long hash;
+			t_CKUINT      shred = 0;
+			bool          seen  = true;
+
+			Program(Name const &name, unsigned long hash)
+			: name(name), hash(hash) { }
+		};
+
+		Allocator &_alloc;
+		ChucK     &_chuck;
+
+		Attached_rom_dataspace _rom;
+
+		List<Program> _programs { };
+
+		Signal_handler<Programs> _update_handler;
+
+		/*
+		 * Noncopyable
+		 */
+		Programs(Programs const &);
+		Programs &operator = (Programs const &);
+
+		static unsigned long _hash(Xml_node node)
+		{
+			/* FNV-1a over the complete node */
+			unsigned long h = 2166136261UL;
+			char const *s = node.addr();
+			for (size_t i = 0; i < node.size(); i++)
+				h = (h ^ (unsigned char)s[i]) * 16777619UL;
+			return h;
+		}
+
+		Program *_lookup(Name const &name)
+		{
+			for (Program *p = _programs.first(); p; p = p->next())
+				if (p->name == name)
+					return p;
+			return nullptr;
+		}
+
+		void _remove_shred(Program &p)
+		{
+			if (!p.shred)
+				return;
+
+			/* processed by the VM at the beginning of the next block */
+			Chuck_Msg *msg = new Chuck_Msg;
+			msg->type  = MSG_REMOVE;
+			msg->param = p.shred;
+			_chuck.vm()->queue_msg(msg, 1);
+
+			p.shred = 0;
+		}
+
+		void _spork(Program &p, Xml_node node)
+		{
+			Path const path = node.attribute_value("path", Path());
+			Args const args = node.attribute_value("args", Args());
+
+			t_CKBOOL ok = FALSE;
+
+			if (path.valid()) {
+				ok = _chuck.compileFile(path.string(), args.string(), 1);
+			} else {
+				size_t const len  = node.content_size() + 1;
+				char * const code = (char *)_alloc.alloc(len);
+				size_t const n    = node.decoded_content(code, len);
+				code[n] = 0;
+
+				ok = _chuck.compileCode(code, args.string(), 1);
+
+				_alloc.free(code, len);
+			}
+
+			if (!ok) {
+				error("failed to compile program '", p.name, "'");
+				return;
+			}
+
+			p.shred = _chuck.vm()->last_id();
+			log("sporked program '", p.name, "' as shred ", p.shred);
+		}
+
+		void _update()
+		{
+			_rom.update();
+
+			for (Program *p = _programs.first(); p; p = p->next())
+				p->seen = false;
+
+			_rom.xml().for_each_sub_node("program", [&] (Xml_node node) {
+				Name const name = node.attribute_value("name", Name());
+				if (!name.valid()) {
+					warning("ignoring program without name");
+					return;
+				}
+
+				unsigned long const hash = _hash(node);
+
+				Program *p = _lookup(name);
+				if (p && p->seen) {
+					warning("ignoring duplicate program '", name, "'");
+					return;
+				}
+
+				if (!p) {
+					p = new (_alloc) Program(name, hash);
+					_programs.insert(p);
+				} else if (p->hash != hash || !p->shred) {
+					_remove_shred(*p);
+					p->hash = hash;
+				} else {
+					/* unchanged */
+					p->seen = true;
+					return;
+				}
+
+				p->seen = true;
+				_spork(*p, node);
+			});
+
+			/* remove programs that vanished from the ROM */
+			for (Program *p = _programs.first(), *next = nullptr; p; p = next) {
+				next = p->next();
+				if (p->seen)
+					continue;
+
+				log("removing program '", p->name, "'");
+				_remove_shred(*p);
+				_programs.remove(p);
+				destroy(_alloc, p);
+			}
+		}
+
+		void _handle_update() { Libc::with_libc([&] () { _update(); }); }
+
+	public:
+
+		Programs(Env &env, Allocator &alloc, ChucK &chuck)
+		:
+			_alloc(alloc), _chuck(chuck), _rom(env, "programs"),
+			_update_handler(env.ep(), *this, &Programs::_handle_update)
+		{
+			_rom.sigh(_update_handler);
+			_update();
+		}
+};
+
+#endif /* _CHUCK__PROGRAMS_H_ */
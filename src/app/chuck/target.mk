@@ -1,6 +1,6 @@
 TARGET := chuck
 
-LIBS += base libc libm pthread stdcxx rtaudio liblo sdl
+LIBS += base libc libm pthread stdcxx liblo sdl
 LIBS += libsndfile libogg libvorbis libFLAC
 
 CHUCK_SRC_DIR = $(call select_from_ports,chuck)/src/app/chuck/src
@@ -9,7 +9,6 @@ CHUCK_HOST_DIR = $(CHUCK_SRC_DIR)/host
 
 CC_OPT += \
 	-D__PLATFORM_GENODE__ \
-	-D__GENODE_AUDIO__ \
 	-D__DISABLE_MIDI__ \
 	-DCPU_IS_LITTLE_ENDIAN=1 \
 	-D__CK_SNDFILE_NATIVE__ \
@@ -32,7 +31,7 @@ LO_SRC_C := \
 
 SRC_C  += $(CHUCK_SRC_C) $(util_sndfile.c)
 SRC_CC += $(filter-out $(CHUCK_SRC_CC_FILTER),$(CHUCK_SRC_CC))
-SRC_CC += dummies.cc chuck_component.cc chuck_audio.cpp
+SRC_CC += dummies.cc chuck_component.cc
 
 vpath %.c   $(CHUCK_CORE_DIR)
 vpath %.cpp $(CHUCK_CORE_DIR) $(CHUCK_HOST_DIR)
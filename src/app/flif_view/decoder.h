@@ -0,0 +1,341 @@
+/*
+ * \brief  Background decoding of FLIF images
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+#ifndef _FLIF_VIEW__DECODER_H_
+#define _FLIF_VIEW__DECODER_H_
+
+/* FLIF includes */
+#include <flif_dec.h>
+
+/* Genode includes */
+#include <timer_session/connection.h>
+#include <base/semaphore.h>
+#include <base/thread.h>
+#include <base/lock.h>
+#include <base/log.h>
+
+/* local includes */
+#include "page_cache.h"
+#include "rgb565.h"
+
+namespace Flif_view { class Decoder; }
+
+
+/**
+ * Thread that decodes files into pages
+ *
+ * The entrypoint reads a file and queues it as job. The decoder thread
+ * converts all frames of the image into a page and hands the page back
+ * as result, announced by a signal. Jobs for pages that are neither the
+ * current page nor one of its neighbours are dropped and a running
+ * decode of such a page is aborted.
+ */
+class Flif_view::Decoder : public Genode::Thread
+{
+	public:
+
+		/*
+		 * Each job yields one final result, progressive previews occupy
+		 * at most half of the job-queue size in addition
+		 */
+		enum { QUEUE_SIZE = 8, RESULT_QUEUE_SIZE = 2*QUEUE_SIZE };
+
+		struct Job
+		{
+			unsigned  serial     = 0;  /* directory listing the index refers to */
+			int       index      = -1;
+			char     *data       = nullptr;
+			size_t    size       = 0;
+			unsigned  max_width  = 0;
+			unsigned  max_height = 0;
+		};
+
+		struct Result
+		{
+			unsigned  serial  = 0;
+			int       index   = -1;
+			Page     *page    = nullptr; /* nullptr if decoding failed or was dropped */
+			bool      preview = false;
+			bool      failed  = false;
+		};
+
+	private:
+
+		enum { STACK_SIZE = 64*1024*sizeof(long) };
+
+		Allocator         &_alloc;
+		Timer::Connection &_timer;
+
+		Signal_context_capability const _sigh;
+
+		Lock      _lock { };
+		Semaphore _jobs_avail { };
+
+		Job      _jobs[QUEUE_SIZE];
+		unsigned _job_head  = 0;
+		unsigned _job_count = 0;
+
+		Result   _results[RESULT_QUEUE_SIZE];
+		unsigned _result_head  = 0;
+		unsigned _result_count = 0;
+
+		/* state shared with the entrypoint */
+		int  _current     = 0;
+		int  _page_count  = 0;
+		bool _progressive = false;
+		bool _verbose     = false;
+
+		Rgb565_converter _converter { };
+
+		/* state of the running decode */
+		Job           _job { };
+		FLIF_DECODER *_dec     = nullptr;
+		unsigned long _last_ms = 0;
+
+		template <typename T>
+		static T _load(T const &v) { return __atomic_load_n(&v, __ATOMIC_ACQUIRE); }
+
+		template <typename T>
+		static void _store(T &v, T n) { __atomic_store_n(&v, n, __ATOMIC_RELEASE); }
+
+		bool _wanted(int index) const
+		{
+			int const cur = _load(_current);
+			int const n   = _load(_page_count);
+
+			return n > 0 && (index == cur
+			              || index == (cur + 1) % n
+			              || index == (cur + n - 1) % n);
+		}
+
+		bool _preview_room()
+		{
+			Lock::Guard guard(_lock);
+			return _result_count < QUEUE_SIZE/2;
+		}
+
+		/**
+		 * Queue a result, previews are dropped if results pile up
+		 */
+		void _result(Result const &result)
+		{
+			{
+				Lock::Guard guard(_lock);
+
+				if (result.preview && _result_count >= QUEUE_SIZE/2) {
+					destroy(_alloc, result.page);
+					return;
+				}
+
+				_results[(_result_head + _result_count++) % RESULT_QUEUE_SIZE] = result;
+			}
+			Signal_transmitter(_sigh).submit();
+		}
+
+		Page *_convert(int index, FLIF_IMAGE **images, unsigned count)
+		{
+			unsigned const w = flif_image_get_width(images[0]);
+			unsigned const h = flif_image_get_height(images[0]);
+
+			unsigned char * const row = (unsigned char *)_alloc.alloc(w*4);
+
+			Page *page = nullptr;
+			try { page = new (_alloc) Page(_alloc, index, Surface_base::Area(w, h), count); }
+			catch (...) {
+				_alloc.free(row, w*4);
+				throw;
+			}
+
+			for (unsigned i = 0; i < count; i++) {
+				for (unsigned y = 0; y < h; y++) {
+					flif_image_read_row_RGBA8(images[i], y, row, w*4);
+					_converter.convert(page->row(i, y), row, w, y);
+				}
+				page->frames[i].delay_ms = flif_image_get_frame_delay(images[i]);
+			}
+
+			_alloc.free(row, w*4);
+
+			page->track_dirty_rows();
+			return page;
+		}
+
+		static ::uint32_t _progress(::uint32_t quality, ::int64_t bytes_read,
+		                            ::uint8_t, void *user_data, void *context)
+		{
+			Decoder &decoder = *(Decoder *)user_data;
+
+			if (_load(decoder._verbose)) {
+				unsigned long const now_ms = decoder._timer.elapsed_ms();
+				double dur_s = double(now_ms - decoder._last_ms) / 1000.0;
+				decoder._last_ms = now_ms;
+				Genode::log((double(bytes_read) / (1 << 20)) / dur_s, " MiB/s");
+			}
+
+			/* abort decoding if input has moved away from the page */
+			if (!decoder._wanted(decoder._job.index)) {
+				flif_abort_decoder(decoder._dec);
+				return 0;
+			}
+
+			if (_load(decoder._progressive)
+			 && decoder._job.index == _load(decoder._current)
+			 && decoder._preview_room()) {
+				flif_decoder_generate_preview(context);
+
+				FLIF_IMAGE *img = flif_decoder_get_image(decoder._dec, 0);
+				try {
+					Result result;
+					result.serial  = decoder._job.serial;
+					result.index   = decoder._job.index;
+					result.page    = decoder._convert(decoder._job.index, &img, 1);
+					result.preview = true;
+					decoder._result(result);
+				} catch (...) { }
+			}
+
+			return ++quality;
+		}
+
+		void _decode()
+		{
+			Result result;
+			result.serial = _job.serial;
+			result.index  = _job.index;
+
+			if (!_wanted(_job.index)) {
+				_result(result);
+				return;
+			}
+
+			_dec = flif_create_decoder();
+			flif_decoder_set_resize(_dec, _job.max_width, _job.max_height);
+			flif_decoder_set_callback(_dec, &_progress, this);
+
+			if (_load(_verbose))
+				_last_ms = _timer.elapsed_ms();
+
+			if (flif_decoder_decode_memory(_dec, _job.data, _job.size)) {
+
+				unsigned const count = flif_decoder_num_images(_dec);
+
+				FLIF_IMAGE **images = (FLIF_IMAGE **)_alloc.alloc(count*sizeof(FLIF_IMAGE *));
+				for (unsigned i = 0; i < count; i++)
+					images[i] = flif_decoder_get_image(_dec, i);
+
+				try { result.page = _convert(_job.index, images, count); }
+				catch (...) { Genode::error("page ", _job.index, " exceeds RAM"); }
+
+				_alloc.free(images, count*sizeof(FLIF_IMAGE *));
+
+				result.failed = !result.page;
+			} else {
+				/* an aborted decode is not a failure of the file */
+				result.failed = _wanted(_job.index);
+			}
+
+			flif_destroy_decoder(_dec);
+			_dec = nullptr;
+
+			_result(result);
+		}
+
+		void entry() override
+		{
+			for (;;) {
+				_jobs_avail.down();
+
+				{
+					Lock::Guard guard(_lock);
+					_job = _jobs[_job_head];
+					_job_head = (_job_head + 1) % QUEUE_SIZE;
+					_job_count--;
+				}
+
+				_decode();
+
+				_alloc.free(_job.data, _job.size);
+			}
+		}
+
+		/*
+		 * Noncopyable
+		 */
+		Decoder(Decoder const &);
+		Decoder &operator = (Decoder const &);
+
+	public:
+
+		Decoder(Genode::Env &env, Allocator &alloc, Timer::Connection &timer,
+		        Signal_context_capability sigh)
+		:
+			Thread(env, "decoder", STACK_SIZE),
+			_alloc(alloc), _timer(timer), _sigh(sigh)
+		{ }
+
+		void progressive(bool enabled) { _store(_progressive, enabled); }
+		void verbose(bool enabled)     { _store(_verbose, enabled); }
+
+		/**
+		 * Set the page the user looks at
+		 */
+		void current(int index, int page_count)
+		{
+			_store(_page_count, page_count);
+			_store(_current, index);
+		}
+
+		/**
+		 * Queue a decoding job, the data is freed by the decoder
+		 *
+		 * The caller must not have more than 'QUEUE_SIZE' jobs without
+		 * result outstanding.
+		 *
+		 * \return false if the queue is full
+		 */
+		bool submit(Job const &job)
+		{
+			{
+				Lock::Guard guard(_lock);
+				if (_job_count == QUEUE_SIZE)
+					return false;
+
+				_jobs[(_job_head + _job_count++) % QUEUE_SIZE] = job;
+			}
+			_jobs_avail.up();
+			return true;
+		}
+
+		/**
+		 * Call 'fn' for each available result
+		 */
+		template <typename FN>
+		void for_each_result(FN const &fn)
+		{
+			for (;;) {
+				Result result;
+				{
+					Lock::Guard guard(_lock);
+					if (!_result_count)
+						return;
+
+					result = _results[_result_head];
+					_result_head = (_result_head + 1) % RESULT_QUEUE_SIZE;
+					_result_count--;
+				}
+				fn(result);
+			}
+		}
+};
+
+#endif /* _FLIF_VIEW__DECODER_H_ */
@@ -11,30 +11,25 @@
  * under the terms of the GNU Affero General Public License version 3.
  */
 
-/* FLIF includes */
-#include <flif_dec.h>
-
 /* Genode includes */
 #include <base/component.h>
 #include <base/heap.h>
-#include <base/attached_ram_dataspace.h>
 #include <base/attached_rom_dataspace.h>
 #include <nitpicker_session/connection.h>
 #include <util/misc_math.h>
-#include <nitpicker_gfx/texture_painter.h>
 #include <timer_session/connection.h>
 #include <base/attached_dataspace.h>
 #include <util/reconstructible.h>
-#include <os/texture_rgb565.h>
 
-/* gems includes */
-#include <gems/texture_utils.h>
-#include <gems/chunky_texture.h>
+/* local includes */
+#include "page_cache.h"
+#include "decoder.h"
 
 /* libc includes */
 #include <libc/component.h>
 extern "C" {
 #include <dirent.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -55,9 +50,11 @@ struct Flif_view::Main
 	Main(Main const &);
 	Main &operator = (Main const &);
 
+	enum { CACHE_DEFAULT = 32 << 20 };
+
 	Libc::Env &env;
 
-	Attached_ram_dataspace back_ds { env.pd(), env.rm(), 0 };
+	Heap heap { env.ram(), env.rm() };
 
 	Nitpicker::Connection nitpicker { env };
 
@@ -67,6 +64,9 @@ struct Flif_view::Main
 	Signal_handler<Main> app_handler {
 		env.ep(), *this, &Main::handle_app_signal };
 
+	Signal_handler<Main> decoded_handler {
+		env.ep(), *this, &Main::handle_decoded_signal };
+
 	Io_signal_handler<Main> input_handler {
 		env.ep(), *this, &Main::handle_input_signal };
 
@@ -82,50 +82,58 @@ struct Flif_view::Main
 
 	Constructible<Attached_dataspace> nit_ds { };
 
-	template <typename PT, typename FN>
-	void apply_to_texture(int width, int height, FN const &fn)
-	{
-		if (nit_mode.width() < width || nit_mode.height() < height) {
-			Mode new_mode(max(nit_mode.width(), width),
-			              max(nit_mode.height(), height),
-			              Mode::RGB565);
-			Genode::log("resize nitpicker buffer to ", new_mode);
-			if (nit_ds.constructed())
-				nit_ds.destruct();
-			nitpicker.buffer(new_mode, false);
-			nit_ds.construct(env.rm(), nitpicker.framebuffer()->dataspace());
-			nit_mode = nitpicker.mode();
-			Genode::log("rebuffering complete");
-		} else if (!nit_ds.constructed()) {
-			nitpicker.buffer(nit_mode, false);
-			nit_ds.construct(env.rm(), nitpicker.framebuffer()->dataspace());
-		}
+	typedef Page::PT PT;
 
-		Genode::size_t const buffer_size =
-			nit_mode.height() * nit_mode.width() * nit_mode.bytes_per_pixel();
+	/*
+	 * The nitpicker buffer holds two frames of the size of 'nit_mode'
+	 * on top of each other. While the view shows the front buffer, the
+	 * next frame is written to the back buffer. The sync signal flips
+	 * the buffers by moving the view offset.
+	 */
+	struct Buffer
+	{
+		unsigned generation = 0; /* 0 if the content is unknown */
+		unsigned frame      = 0;
+	};
 
-		if (buffer_size > back_ds.size())
-			back_ds.realloc(&env.pd(), buffer_size);
+	Buffer   buffers[2];
+	unsigned front = 0;
 
-		Surface_base::Area nit_area(nit_mode.width(), nit_mode.height());
-		Texture<PT> texture(back_ds.local_addr<PT>(), nullptr, nit_area);
+	/* incremented whenever a different page or preview is shown */
+	unsigned generation = 0;
 
-		fn(texture);
+	/**
+	 * Make sure that the buffers fit an image of the given size
+	 */
+	void prepare_buffers(int width, int height)
+	{
+		if (nit_ds.constructed()
+		 && nit_mode.width() >= width && nit_mode.height() >= height)
+			return;
+
+		nit_mode = Mode(max(nit_mode.width(), width),
+		                max(nit_mode.height(), height),
+		                Mode::RGB565);
+
+		Genode::log("resize nitpicker buffer to ", nit_mode);
+		if (nit_ds.constructed())
+			nit_ds.destruct();
+		nitpicker.buffer(Mode(nit_mode.width(), 2*nit_mode.height(),
+		                      Mode::RGB565), false);
+		nit_ds.construct(env.rm(), nitpicker.framebuffer()->dataspace());
+
+		buffers[0] = buffers[1] = Buffer();
+		front = 0;
 	}
 
 	void handle_sync_signal()
 	{
-		typedef Pixel_rgb565 PT;
-
-		Surface_base::Area nit_area(nit_mode.width(), nit_mode.height());
+		front = !front;
 
-		Texture<PT> texture(back_ds.local_addr<PT>(), nullptr, nit_area);
-		Surface<PT> surface(nit_ds->local_addr<PT>(), nit_area);
-
-		Texture_painter::paint(
-			surface, texture, Color(), Surface_base::Point(),
-			Texture_painter::SOLID, true);
+		int const offset = front*nit_mode.height();
 
+		nitpicker.enqueue<Command::Offset>(
+			view_handle, Nitpicker::Point(0, -offset));
 		nitpicker.enqueue<Command::Geometry>(
 			view_handle, Nitpicker::Rect(Nitpicker::Point(), img_area));
 		nitpicker.enqueue<Command::To_front>(view_handle);
@@ -147,63 +155,91 @@ struct Flif_view::Main
 
 	Nitpicker::Session::View_handle view_handle = nitpicker.create_view();
 
-	void render(FLIF_IMAGE *img);
+	/* decoded pages, the current page and its neighbours are never evicted */
+	Page_cache cache { heap, CACHE_DEFAULT };
+
+	Decoder decoder { env, heap, timer, decoded_handler };
 
-	FLIF_DECODER *flif_dec = NULL;
+	/* progressive preview of the current page, not cached */
+	Page *preview = nullptr;
 
 	struct dirent **namelist = NULL;
 	int page_count = 0;
 
+	/* pages with a decoding job in flight */
+	bool *requested = nullptr;
+	int   in_flight = 0;
+
+	/* incremented with each directory scan to spot stale results */
+	unsigned listing = 0;
+
+	/*
+	 * Input moves the pending index, the application follows with the
+	 * current index. Both are not wrapped at the page count.
+	 */
 	int cur_page_index = 0;
 	int pending_page_index = 0;
-	int cur_frame = 0;
+	int direction = 1;
+	int skipped = 0;
 
-	unsigned long last_ms = 0;
+	int shown_index = -1;
+	unsigned cur_frame = 0;
 
 	bool progressive = false;
 	bool verbose = false;
 
-	bool render_page();
+	int wrap(int index) const {
+		return page_count > 0 ? ((index % page_count) + page_count) % page_count : 0; }
 
-	void next_page()
+	int cur_page() const { return wrap(cur_page_index); }
+
+	/**
+	 * Return true for the current page and its neighbours
+	 */
+	bool wanted(int index) const
 	{
-		while (true) {
-			++cur_page_index;
-			if (cur_page_index > page_count-1)
-				cur_page_index = 0;
-			if (render_page())
-				break;
-		}
+		return index == cur_page()
+		    || index == wrap(cur_page_index + 1)
+		    || index == wrap(cur_page_index - 1);
 	}
 
-	void prev_page()
+	char const *filename(int index) const { return namelist[index]->d_name; }
+
+	void render(Page const &page, unsigned frame);
+
+	void display(Page const &page);
+
+	bool request(int index);
+
+	void show_page();
+
+	void drop_preview()
 	{
-		while (true) {
-			--cur_page_index;
-			if (cur_page_index < 0)
-				cur_page_index = page_count-1;
-			if (render_page())
-				break;
+		if (preview) {
+			destroy(heap, preview);
+			preview = nullptr;
 		}
 	}
 
 	void handle_app_signal()
 	{
-		if (cur_page_index < pending_page_index) {
-			Libc::with_libc([&] () { next_page(); });
-		} else
-		if (cur_page_index > pending_page_index) {
-			Libc::with_libc([&] () { prev_page(); });
-		}
+		if (cur_page_index == pending_page_index)
+			return;
+
+		direction = pending_page_index > cur_page_index ? 1 : -1;
+		cur_page_index = pending_page_index;
+		skipped = 0;
+
+		Libc::with_libc([&] () { show_page(); });
 	}
 
-	void handle_config()
-	{
-		progressive = config_rom.xml().attribute_value(
-			"progressive", progressive);
-		verbose = config_rom.xml().attribute_value(
-			"verbose", verbose);
+	void handle_decoded();
+
+	void handle_decoded_signal() {
+		Libc::with_libc([&] () { handle_decoded(); }); }
 
+	void clear_listing()
+	{
 		while (page_count > 0) {
 			--page_count;
 			free(namelist[page_count]);
@@ -212,10 +248,52 @@ struct Flif_view::Main
 			free(namelist);
 			namelist = NULL;
 		}
+	}
+
+	static int regular_file(struct dirent const *d) {
+		return d->d_type != DT_DIR; }
 
-		page_count = scandir(".", &namelist, NULL, alphasort);
+	void handle_config()
+	{
+		Xml_node const config = config_rom.xml();
+
+		progressive = config.attribute_value("progressive", progressive);
+		verbose     = config.attribute_value("verbose", verbose);
+
+		decoder.progressive(progressive);
+		decoder.verbose(verbose);
+
+		/* the files may have changed, decode them again */
+		render_timeout.discard();
+		drop_preview();
+		cache.flush();
+		cache.budget(config.attribute_value("cache",
+		                                    Number_of_bytes(CACHE_DEFAULT)));
+		shown_index = -1;
+
+		if (requested) {
+			heap.free(requested, page_count*sizeof(bool));
+			requested = nullptr;
+		}
+		clear_listing();
 
-		render_page();
+		page_count = scandir(".", &namelist, regular_file, alphasort);
+		if (page_count < 0) {
+			Genode::error("failed to read directory");
+			page_count = 0;
+			return;
+		}
+
+		listing++;
+		if (page_count == 0)
+			return;
+
+		requested = (bool *)heap.alloc(page_count*sizeof(bool));
+		for (int i = 0; i < page_count; i++)
+			requested[i] = false;
+
+		skipped = 0;
+		show_page();
 	}
 
 	void handle_config_signal()
@@ -248,6 +326,8 @@ struct Flif_view::Main
 
 	Main(Libc::Env &env) : env(env)
 	{
+		decoder.start();
+
 		input.sigh(input_handler);
 		config_rom.sigh(config_handler);
 
@@ -256,105 +336,238 @@ struct Flif_view::Main
 };
 
 
-static ::uint32_t progressive_render(::uint32_t quality, ::int64_t bytes_read, ::uint8_t /*decode_over*/, void *user_data, void *context)
+void Flif_view::Main::render_animation(Genode::Duration)
 {
-	auto *main = (Flif_view::Main*)user_data;
+	/* the page may have been evicted since the last frame */
+	Page *page = cache.lookup(shown_index);
+	if (!page || page->frame_count < 2)
+		return;
 
-	if (main->verbose) {
-		unsigned long const now_ms = main->timer.elapsed_ms();
-		double dur_s = double(now_ms - main->last_ms) / 1000.0;
-		main->last_ms = now_ms;
-		Genode::log((double(bytes_read) / (1 << 20)) / dur_s, " MiB/s");
-	}
+	cur_frame = (cur_frame+1) % page->frame_count;
 
-	if (main->progressive) {
-		flif_decoder_generate_preview(context);
+	render(*page, cur_frame);
+	render_timeout.schedule(
+		Microseconds(page->frames[cur_frame].delay_ms*1000UL));
+}
 
-		FLIF_IMAGE *img = flif_decoder_get_image(main->flif_dec, 0);
-		main->render(img);
-	}
 
-	/* abort decoding if input has moved the page index */
-	if (main->cur_page_index != main->pending_page_index) {
-		flif_abort_decoder(main->flif_dec);
-		return 0;
-	}
+void Flif_view::Main::render(Page const &page, unsigned frame)
+{
+	unsigned const f_width  = page.area.w();
+	unsigned const f_height = page.area.h();
 
-	return ++quality;
-}
+	prepare_buffers(f_width, f_height);
 
+	/* frames are written to the back buffer until the next sync flips */
+	unsigned const back = !front;
+	Buffer &buffer = buffers[back];
 
-void Flif_view::Main::render_animation(Genode::Duration)
-{
-	cur_frame = (cur_frame+1) % flif_decoder_num_images(flif_dec);
+	unsigned top = 0, bottom = f_height;
 
-	FLIF_IMAGE *img = flif_decoder_get_image(flif_dec, cur_frame);
-	render(img);
-	auto x = Microseconds(flif_image_get_frame_delay(img)*100);
-	render_timeout.schedule(x);
-}
+	if (buffer.generation == generation) {
 
+		/* accumulate the rows changed since the frame in the buffer */
+		top = f_height; bottom = 0;
+		for (unsigned f = buffer.frame; f != frame; ) {
+			f = (f + 1) % page.frame_count;
 
-void Flif_view::Main::render(FLIF_IMAGE *img)
-{
-	int const f_width  = flif_image_get_width(img);
-	int const f_height = flif_image_get_height(img);
-
-	typedef Pixel_rgb565 PT;
-	apply_to_texture<PT>(f_width, f_height, [&] (Texture<PT> &texture) {
-		/* fill texture with FLIF image data */
-		char row[f_width*4];
-		for (int y = 0; y < f_height; ++y) {
-			flif_image_read_row_RGBA8(img, y, &row, sizeof(row));
-			texture.rgba((unsigned char*)&row, f_width, y);
+			Page::Frame const &changed = page.frames[f];
+			if (changed.dirty_top >= changed.dirty_bottom)
+				continue;
+
+			top    = min(top,    changed.dirty_top);
+			bottom = max(bottom, changed.dirty_bottom);
 		}
-	});
+	}
+
+	unsigned const stride = nit_mode.width();
+	PT * const dst = nit_ds->local_addr<PT>() + back*nit_mode.height()*stride;
 
-	/* flush to surface on next sync signal */
+	for (unsigned y = top; y < bottom; ++y)
+		Genode::memcpy(dst + y*stride, page.row(frame, y), f_width*sizeof(PT));
+
+	buffer.generation = generation;
+	buffer.frame      = frame;
+
+	/* flip on next sync signal */
 	img_area = Surface_base::Area(f_width, f_height);
 	nitpicker.framebuffer()->sync_sigh(sync_handler);
 }
 
 
-bool Flif_view::Main::render_page()
+void Flif_view::Main::display(Page const &page)
 {
-	pending_page_index = cur_page_index;
+	render_timeout.discard();
 
-	struct dirent *d = namelist[cur_page_index];
-	char const *filename = d->d_name;
+	cur_frame   = 0;
+	shown_index = page.index;
+	skipped     = 0;
+	generation++;
 
-	if (flif_dec != NULL) {
-		flif_destroy_decoder(flif_dec);
-		flif_dec = NULL;
-	}
+	render(page, 0);
 
-	flif_dec = flif_create_decoder();
-	flif_decoder_set_resize(flif_dec, nit_mode.width(), nit_mode.height());
-	flif_decoder_set_callback(flif_dec, &(progressive_render), this);
+	if (page.frame_count > 1)
+		render_timeout.schedule(
+			Microseconds(page.frames[0].delay_ms*1000UL));
+}
 
-	nitpicker.enqueue<Nitpicker::Session::Command::Title>(view_handle, filename);
 
-	if (verbose)
-		last_ms = timer.elapsed_ms();
+/**
+ * Read a file and queue it for decoding unless it is cached or in flight
+ */
+bool Flif_view::Main::request(int index)
+{
+	if (page_count == 0 || requested[index] || cache.lookup(index))
+		return true;
 
-	if (!flif_decoder_decode_file(flif_dec, filename)) {
-		Genode::error("decode '", filename, "' failed");
+	/* retried when the next result arrives */
+	if (in_flight >= Decoder::QUEUE_SIZE)
+		return true;
+
+	FILE *file = fopen(filename(index), "r");
+	if (!file) {
+		Genode::error("failed to open '", filename(index), "'");
 		return false;
 	}
 
-	Genode::log(filename);
+	fseek(file, 0, SEEK_END);
+	long const size = ftell(file);
+	fseek(file, 0, SEEK_SET);
 
-	FLIF_IMAGE *img = flif_decoder_get_image(flif_dec, 0);
-	render(img);
+	if (size <= 0) {
+		fclose(file);
+		Genode::error("'", filename(index), "' is empty");
+		return false;
+	}
 
-	if (flif_decoder_num_images(flif_dec) > 1) {
-		render_timeout.schedule(
-			Microseconds(flif_image_get_frame_delay(img)));
+	Decoder::Job job;
+	job.serial     = listing;
+	job.index      = index;
+	job.size       = size;
+	job.data       = (char *)heap.alloc(job.size);
+	job.max_width  = nit_mode.width();
+	job.max_height = nit_mode.height();
+
+	size_t const n = fread(job.data, 1, job.size, file);
+	fclose(file);
+
+	if (n != job.size) {
+		heap.free(job.data, job.size);
+		Genode::error("failed to read '", filename(index), "'");
+		return false;
 	}
 
+	if (!decoder.submit(job)) {
+		heap.free(job.data, job.size);
+		return true;
+	}
+
+	requested[index] = true;
+	in_flight++;
 	return true;
 }
 
 
+void Flif_view::Main::show_page()
+{
+	if (page_count == 0)
+		return;
+
+	int const index = cur_page();
+
+	decoder.current(index, page_count);
+
+	/* stop animating the page that is left */
+	render_timeout.discard();
+
+	nitpicker.enqueue<Command::Title>(view_handle, filename(index));
+
+	if (Page *page = cache.lookup(index)) {
+		drop_preview();
+		display(*page);
+		if (verbose)
+			Genode::log(filename(index), " (cached)");
+	} else
+	if (!request(index)) {
+		/* skip unreadable files in the direction of travel */
+		if (++skipped < page_count) {
+			cur_page_index += direction;
+			pending_page_index += direction;
+			show_page();
+		}
+		return;
+	}
+
+	/* decode the neighbours while the user looks at this page */
+	request(wrap(cur_page_index + direction));
+	request(wrap(cur_page_index - direction));
+}
+
+
+void Flif_view::Main::handle_decoded()
+{
+	bool skip = false;
+
+	decoder.for_each_result([&] (Decoder::Result const &result) {
+
+		bool const stale = result.serial != listing;
+
+		if (!result.preview) {
+			in_flight--;
+			if (!stale)
+				requested[result.index] = false;
+		}
+
+		bool const current = !stale && result.index == cur_page();
+
+		if (result.preview) {
+			if (current && shown_index != result.index) {
+				drop_preview();
+				preview = result.page;
+				generation++;
+				render(*preview, 0);
+			} else
+				destroy(heap, result.page);
+			return;
+		}
+
+		if (stale) {
+			if (result.page)
+				destroy(heap, result.page);
+			return;
+		}
+
+		if (result.page) {
+			cache.insert(*result.page, [&] (int index) { return wanted(index); });
+			if (current) {
+				drop_preview();
+				Genode::log(filename(result.index));
+				display(*result.page);
+			}
+			return;
+		}
+
+		if (result.failed) {
+			Genode::error("decode '", filename(result.index), "' failed");
+			if (current)
+				skip = true;
+		}
+	});
+
+	if (skip && ++skipped < page_count) {
+		cur_page_index += direction;
+		pending_page_index += direction;
+		show_page();
+		return;
+	}
+
+	/* request aborted or postponed pages that are wanted again */
+	if (page_count > 0 && shown_index != cur_page())
+		request(cur_page());
+	request(wrap(cur_page_index + direction));
+	request(wrap(cur_page_index - direction));
+}
+
+
 void Libc::Component::construct(Libc::Env &env) {
 	with_libc([&env] () { static Flif_view::Main application(env); }); }
@@ -0,0 +1,214 @@
+/*
+ * \brief  Cache of decoded pages
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+#ifndef _FLIF_VIEW__PAGE_CACHE_H_
+#define _FLIF_VIEW__PAGE_CACHE_H_
+
+/* Genode includes */
+#include <os/surface.h>
+#include <os/pixel_rgb565.h>
+#include <base/allocator.h>
+#include <util/string.h>
+#include <util/list.h>
+
+namespace Flif_view {
+	using namespace Genode;
+
+	struct Page;
+	class Page_cache;
+}
+
+
+/**
+ * Frames of a decoded image in the pixel format of the nitpicker buffer
+ */
+struct Flif_view::Page : List<Page>::Element
+{
+	typedef Pixel_rgb565 PT;
+
+	struct Frame
+	{
+		PT      *pixels;
+		unsigned delay_ms;
+
+		/* rows [dirty_top, dirty_bottom) differ from the previous frame */
+		unsigned dirty_top;
+		unsigned dirty_bottom;
+	};
+
+	Allocator &alloc;
+
+	int                const index;
+	Surface_base::Area const area;
+	unsigned           const frame_count;
+
+	Frame * const frames;
+
+	Page(Allocator &alloc, int index, Surface_base::Area area, unsigned count)
+	:
+		alloc(alloc), index(index), area(area), frame_count(count),
+		frames((Frame *)alloc.alloc(count*sizeof(Frame)))
+	{
+		for (unsigned i = 0; i < frame_count; i++)
+			frames[i] = Frame { nullptr, 0, 0, (unsigned)area.h() };
+
+		try {
+			for (unsigned i = 0; i < frame_count; i++)
+				frames[i].pixels = (PT *)alloc.alloc(frame_size());
+		} catch (...) {
+			_free();
+			throw;
+		}
+	}
+
+	~Page() { _free(); }
+
+	size_t frame_size() const { return area.count()*sizeof(PT); }
+
+	size_t bytes() const { return frame_count*(frame_size() + sizeof(Frame)); }
+
+	PT *row(unsigned frame, unsigned y) const {
+		return frames[frame].pixels + y*area.w(); }
+
+	/**
+	 * Determine the rows of each frame that changed with respect to the
+	 * preceding frame, the first frame follows the last one
+	 */
+	void track_dirty_rows()
+	{
+		size_t const row_size = area.w()*sizeof(PT);
+
+		for (unsigned i = 0; i < frame_count && frame_count > 1; i++) {
+			unsigned const prev = (i + frame_count - 1) % frame_count;
+
+			unsigned top = 0, bottom = (unsigned)area.h();
+			while (top < bottom && !Genode::memcmp(row(i, top), row(prev, top), row_size))
+				top++;
+			while (bottom > top && !Genode::memcmp(row(i, bottom - 1), row(prev, bottom - 1), row_size))
+				bottom--;
+
+			frames[i].dirty_top    = top;
+			frames[i].dirty_bottom = bottom;
+		}
+	}
+
+	private:
+
+		void _free()
+		{
+			for (unsigned i = 0; i < frame_count; i++)
+				if (frames[i].pixels)
+					alloc.free(frames[i].pixels, frame_size());
+			alloc.free(frames, frame_count*sizeof(Frame));
+		}
+
+		/*
+		 * Noncopyable
+		 */
+		Page(Page const &);
+		Page &operator = (Page const &);
+};
+
+
+/**
+ * Least-recently-used set of pages bounded by a RAM budget
+ */
+class Flif_view::Page_cache
+{
+	private:
+
+		Allocator &_alloc;
+
+		size_t _budget;
+		size_t _used = 0;
+
+		/* most recently used page first */
+		List<Page> _pages { };
+
+		void _destroy(Page &page)
+		{
+			_pages.remove(&page);
+			_used -= page.bytes();
+			destroy(_alloc, &page);
+		}
+
+		/*
+		 * Noncopyable
+		 */
+		Page_cache(Page_cache const &);
+		Page_cache &operator = (Page_cache const &);
+
+	public:
+
+		Page_cache(Allocator &alloc, size_t budget)
+		: _alloc(alloc), _budget(budget) { }
+
+		~Page_cache() { flush(); }
+
+		void budget(size_t budget) { _budget = budget; }
+
+		size_t used() const { return _used; }
+
+		/**
+		 * Return cached page and mark it as recently used
+		 */
+		Page *lookup(int index)
+		{
+			for (Page *p = _pages.first(); p; p = p->next()) {
+				if (p->index != index)
+					continue;
+
+				_pages.remove(p);
+				_pages.insert(p);
+				return p;
+			}
+			return nullptr;
+		}
+
+		/**
+		 * Take ownership of a page and evict pages beyond the budget
+		 *
+		 * \param pinned  functor that returns true for the index of a page
+		 *                that must not be evicted
+		 *
+		 * Pinned pages are kept even if they exceed the budget, so that
+		 * a page is never evicted while it is still wanted and thereby
+		 * decoded over and over.
+		 */
+		template <typename FN>
+		void insert(Page &page, FN const &pinned)
+		{
+			_pages.insert(&page);
+			_used += page.bytes();
+
+			while (_used > _budget) {
+				Page *victim = nullptr;
+				for (Page *p = _pages.first(); p; p = p->next())
+					if (!pinned(p->index))
+						victim = p;
+
+				if (!victim)
+					break;
+
+				_destroy(*victim);
+			}
+		}
+
+		void flush()
+		{
+			while (Page *p = _pages.first())
+				_destroy(*p);
+		}
+};
+
+#endif /* _FLIF_VIEW__PAGE_CACHE_H_ */
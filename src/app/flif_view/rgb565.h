@@ -0,0 +1,114 @@
+/*
+ * \brief  Conversion of RGBA8 rows to dithered RGB565
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+#ifndef _FLIF_VIEW__RGB565_H_
+#define _FLIF_VIEW__RGB565_H_
+
+/* Genode includes */
+#include <os/dither_matrix.h>
+#include <os/pixel_rgb565.h>
+#include <base/stdint.h>
+
+namespace Flif_view { class Rgb565_converter; }
+
+
+/**
+ * Converter of RGBA8 rows to RGB565 pixels
+ *
+ * The result equals 'Texture<Pixel_rgb565>::rgba' including the ordered
+ * dithering, but 16 pixels are converted at once using the generic vector
+ * extension of GCC, which maps to SSE2 or NEON instructions. Bytes are
+ * dithered with a saturating add, the channels are packed within 32-bit
+ * lanes, and the lower halves of the lanes are gathered by a shuffle.
+ * The pixel bytes are expected in little-endian order.
+ */
+class Flif_view::Rgb565_converter
+{
+	private:
+
+		typedef Genode::uint16_t uint16_t;
+		typedef Genode::uint32_t uint32_t;
+		typedef Genode::int16_t  int16_t;
+
+		typedef unsigned char v16u8 __attribute__((vector_size(16)));
+		typedef uint32_t      v4u32 __attribute__((vector_size(16)));
+		typedef uint16_t      v8u16 __attribute__((vector_size(16)));
+		typedef int16_t       v8s16 __attribute__((vector_size(16)));
+
+		/* width of the dither matrix */
+		enum { BLOCK = 16, BLOCK_BYTES = BLOCK*4 };
+
+		/* dither offset of each byte of a block for the current row */
+		union {
+			v16u8         _dither[BLOCK_BYTES/16];
+			unsigned char _dither_bytes[BLOCK_BYTES];
+		};
+
+		static uint16_t _pixel(unsigned char const *rgba, unsigned d)
+		{
+			unsigned const r = rgba[0] + d, g = rgba[1] + d, b = rgba[2] + d;
+
+			return (uint16_t)(((r > 255 ? 255 : r) & 0xf8) << 8
+			                | ((g > 255 ? 255 : g) & 0xfc) << 3
+			                |  (b > 255 ? 255 : b) >> 3);
+		}
+
+		static v4u32 _pack(v16u8 v, v16u8 d)
+		{
+			v16u8 s = v + d;
+			s |= (v16u8)(s < v); /* saturate on overflow */
+
+			v4u32 const p = (v4u32)s;
+			return ((p & 0xf8) << 8) | ((p >> 5) & 0x7e0) | ((p >> 19) & 0x1f);
+		}
+
+		static v8u16 _pack8(v16u8 lo, v16u8 hi, v16u8 d_lo, v16u8 d_hi)
+		{
+			v8s16 const even = { 0, 2, 4, 6, 8, 10, 12, 14 };
+			return __builtin_shuffle((v8u16)_pack(lo, d_lo),
+			                         (v8u16)_pack(hi, d_hi), even);
+		}
+
+	public:
+
+		/**
+		 * Convert a row of RGBA8 pixels
+		 *
+		 * \param y  row within the image, selects the dither pattern
+		 */
+		void convert(Genode::Pixel_rgb565 *dst, unsigned char const *rgba,
+		             unsigned width, int y)
+		{
+			for (unsigned i = 0; i < BLOCK_BYTES; i++)
+				_dither_bytes[i] = Genode::Dither_matrix::value(i/4, y) >> 5;
+
+			uint16_t * const out = (uint16_t *)dst;
+
+			unsigned x = 0;
+			for (; x + BLOCK <= width; x += BLOCK) {
+				v16u8 src[BLOCK_BYTES/16];
+				__builtin_memcpy(src, rgba + x*4, BLOCK_BYTES);
+
+				v8u16 const lo = _pack8(src[0], src[1], _dither[0], _dither[1]);
+				v8u16 const hi = _pack8(src[2], src[3], _dither[2], _dither[3]);
+
+				__builtin_memcpy(out + x,     &lo, sizeof(lo));
+				__builtin_memcpy(out + x + 8, &hi, sizeof(hi));
+			}
+
+			for (; x < width; x++)
+				out[x] = _pixel(rgba + x*4, _dither_bytes[(x % BLOCK)*4]);
+		}
+};
+
+#endif /* _FLIF_VIEW__RGB565_H_ */
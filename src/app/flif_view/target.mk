@@ -1,5 +1,5 @@
 TARGET += flif_view
-LIBS += base libflif libc blit stdcxx
+LIBS += base libflif libc stdcxx
 SRC_CC = flif_view.cc
 
 CC_CXX_WARN_STRICT =
@@ -19,38 +19,51 @@
 #include <os/reporter.h>
 #include <rtc_session/connection.h>
 #include <timer_session/connection.h>
+#include <base/attached_rom_dataspace.h>
+#include <base/heap.h>
 #include <base/log.h>
 
-/* Crypto++ includes */
-#include <hmac.h>
-#include <sha.h>
+/* local includes */
+#include "secret.h"
 
+namespace Gtotp { struct Main; }
 
-struct Main
+
+/**
+ * Reporter of the codes of all configured secrets
+ *
+ * The codes of all secrets are updated in one pass whenever the period of
+ * any secret ends, and the report is generated once per pass.
+ */
+struct Gtotp::Main
 {
-	Genode::Env &env;
+	Env &env;
 
-	Timer::Connection timer    { env };
-	Genode::Reporter  reporter { env, "otp" };
+	Heap heap { env.ram(), env.rm() };
 
-	CryptoPP::HMAC<CryptoPP::SHA1> hmac;
+	Timer::Connection timer { env };
 
-	Timer::Periodic_timeout<Main> update_timeout {
-		timer, *this, &Main::update, Genode::Microseconds(30*1000*1000) };
+	Attached_rom_dataspace config_rom { env, "config" };
 
-	static Genode::uint64_t rtc_nonce(Genode::Env &env)
-	{
-		using namespace Genode;
-		typedef Genode::uint64_t uint64_t;
+	Constructible<Reporter> reporter { };
 
-		Rtc::Timestamp const ts = Rtc::Connection(env).current_time();;
+	/* secrets in the order of the configuration */
+	List<Secret> secrets { };
 
-		enum {
-			PERIOD = 30 /* seconds */,
-			PERIODS_PER_MINUTE = 60 / PERIOD,
-			PERIODS_PER_HOUR   = PERIODS_PER_MINUTE*60,
-			PERIODS_PER_DAY    = PERIODS_PER_HOUR*24
-		};
+	/* report the first code as 'value' attribute as done formerly */
+	bool legacy = false;
+
+	Signal_handler<Main> config_handler {
+		env.ep(), *this, &Main::handle_config };
+
+	Timer::One_shot_timeout<Main> update_timeout {
+		timer, *this, &Main::update };
+
+	uint64_t timer_us() { return timer.curr_time().trunc_to_plain_us().value; }
+
+	static uint64_t rtc_seconds(Env &env)
+	{
+		Rtc::Timestamp const ts = Rtc::Connection(env).current_time();
 
 		unsigned const m = (ts.month + 9) % 12;
 		unsigned const y = ts.year - m/10;
@@ -59,135 +72,143 @@ struct Main
 			(m*306 + 5)/10 + (ts.day - 1) - 719468;
 
 		return
-			(uint64_t)days*PERIODS_PER_DAY +
-			(uint64_t)ts.hour*PERIODS_PER_HOUR +
-			(uint64_t)ts.minute*PERIODS_PER_MINUTE +
-			(uint64_t)ts.second/PERIOD;
+			(uint64_t)days*24*60*60 +
+			(uint64_t)ts.hour*60*60 +
+			(uint64_t)ts.minute*60 +
+			(uint64_t)ts.second;
 	}
 
-	uint64_t const initial_nonce = rtc_nonce(env);
+	/* offset of the timer to the UNIX epoch */
+	uint64_t const epoch_us = rtc_seconds(env)*1000*1000 - timer_us();
 
-	void update(Genode::Duration dur)
+	void update(Duration)
 	{
-		uint64_t const nonce =
-			initial_nonce + dur.trunc_to_plain_ms().value / (30 * 1000);
-
-		uint8_t nonce_digest[hmac.DigestSize()];
-		uint8_t nonce_buf[8];
-
-		nonce_buf[0] = nonce >> (7 * 8) & 0xff;
-		nonce_buf[1] = nonce >> (6 * 8) & 0xff;
-		nonce_buf[2] = nonce >> (5 * 8) & 0xff;
-		nonce_buf[3] = nonce >> (4 * 8) & 0xff;
-		nonce_buf[4] = nonce >> (3 * 8) & 0xff;
-		nonce_buf[5] = nonce >> (2 * 8) & 0xff;
-		nonce_buf[6] = nonce >> (1 * 8) & 0xff;
-		nonce_buf[7] = nonce >> (0 * 8) & 0xff;
-
-		hmac.Update(nonce_buf, sizeof(nonce_buf));
-		hmac.Final(nonce_digest);
-		hmac.Restart();
-
-		unsigned const offset =
-			nonce_digest[sizeof(nonce_digest)-1] & 0x0F;
-
-		uint32_t code;
-		code  = (nonce_digest[offset+0]&0x7F) << (3 * 8);
-		code +=  nonce_digest[offset+1] << (2 * 8);
-		code +=  nonce_digest[offset+2] << (1 * 8);
-		code +=  nonce_digest[offset+3] << (0 * 8);
-
-		code = code % 1000000;
-
-		char buf[7] { 0 };
-		buf[0] = 0x30 | (code/100000);
-		buf[1] = 0x30 | ((code/10000) % 10);
-		buf[2] = 0x30 | ((code/1000) % 10);
-		buf[3] = 0x30 | ((code/100) % 10);
-		buf[4] = 0x30 | ((code/10) % 10);
-		buf[5] = 0x30 | (code%10);
-
-		{
-			using namespace Genode;
-
-			Reporter::Xml_generator gen(reporter, [&] () {
-				gen.attribute("value", (char const *)buf);
+		uint64_t const now_us  = epoch_us + timer_us();
+		uint64_t const seconds = now_us / (1000*1000);
+
+		bool     changed = false;
+		uint64_t next    = ~0ULL;
+
+		for (Secret *s = secrets.first(); s; s = s->next()) {
+			changed |= s->update(seconds);
+			next     = min(next, s->expires());
+		}
+
+		if (!secrets.first())
+			return;
+
+		if (changed) {
+			Reporter::Xml_generator xml(*reporter, [&] () {
+				if (legacy)
+					xml.attribute("value", secrets.first()->value().string());
+
+				for (Secret *s = secrets.first(); s; s = s->next())
+					s->report(xml);
 			});
 		}
-	}
 
-	Main(Genode::Env &env, uint8_t *secret, size_t secret_len)
-	: env(env), hmac(secret, secret_len)
-	{
-		reporter.enabled(true);
+		update_timeout.schedule(Microseconds(next*1000*1000 - now_us));
 	}
-};
 
+	Secret *create_secret(Xml_node node, char const *key_attr,
+	                      Name const &name, unsigned default_window)
+	{
+		Base32 b32;
+		Key    key;
+
+		try {
+			Xml_attribute const attr = node.attribute(key_attr);
+			if (attr.value_size() >= Base32::capacity()) {
+				error("key of secret '", name, "' exceeds ", (int)MAX_KEY_LEN, " bytes");
+				return nullptr;
+			}
+			attr.value(&b32);
+		} catch (Xml_node::Nonexistent_attribute) {
+			error("'", key_attr, "' attribute missing from secret '", name, "'");
+			return nullptr;
+		}
 
-void Libc::Component::construct(Libc::Env &env)
-{
-	using namespace Genode;
+		if (!base32_decode(b32, key)) {
+			error("key of secret '", name, "' is not valid base32");
+			return nullptr;
+		}
 
-	enum {
-		BASE32_FACTOR   = 256 / 32,
-		MAX_SECRET_BIN_LEN = 20,
-		MAX_SECRET_STR_LEN = MAX_SECRET_BIN_LEN * BASE32_FACTOR
-	};
+		Algorithm const algorithm = node.attribute_value("algorithm", Algorithm("sha1"));
+		unsigned  const period    = node.attribute_value("period", 30U);
+		unsigned  const digits    = node.attribute_value("digits", 6U);
+		unsigned  const window    = node.attribute_value("window", default_window);
 
-	size_t i = 0;
-	uint8_t binsec[MAX_SECRET_BIN_LEN];
+		if (!Secret::supported(algorithm)) {
+			error("secret '", name, "' has unsupported algorithm '", algorithm, "'");
+			return nullptr;
+		}
 
-	{
-		Genode::uint8_t base32_table[256];
+		if (period == 0 || digits < 1 || digits > 9) {
+			error("secret '", name, "' has invalid period or digits");
+			return nullptr;
+		}
 
-		char const *upper = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
-		char const *lower = "abcdefghijklmnopqrstuvwxyz";
+		return Secret::create(heap, name, algorithm, key, period, digits,
+		                      min(window, (unsigned)MAX_WINDOW));
+	}
 
-		for (int i = 0; i < 256; ++i)
-			base32_table[i] = 0xFF;
+	void handle_config()
+	{
+		config_rom.update();
+		Xml_node const config = config_rom.xml();
 
-		for (int i = 0; i < 32; ++i)
-			base32_table[(uint8_t)upper[i]] = i;
+		while (Secret *s = secrets.first()) {
+			secrets.remove(s);
+			destroy(heap, s);
+		}
 
-		for (int i = 0; i < 26; ++i)
-			base32_table[(uint8_t)lower[i]] = i;
+		unsigned const window = config.attribute_value("window", 0U);
 
-		typedef String<MAX_SECRET_STR_LEN+1> Secret_string;
+		Secret *last = nullptr;
+		auto append = [&] (Secret *s) {
+			if (!s) return;
+			secrets.insert(s, last);
+			last = s;
+		};
 
-		Secret_string secret_string;
+		legacy = config.has_attribute("secret");
+		if (legacy)
+			append(create_secret(config, "secret", Name("default"), window));
 
-		env.config([&] (Xml_node const &node) {
-			try {
-				node.attribute("secret").value(&secret_string); }
-			catch (Xml_node::Nonexistent_attribute) {
-				error("'secret' attribute missing from gtotp VFS node");
-				throw;
+		config.for_each_sub_node("secret", [&] (Xml_node node) {
+			Name const name = node.attribute_value("name", Name());
+			if (!name.valid()) {
+				error("ignoring secret without name");
+				return;
 			}
+			append(create_secret(node, "key", name, window));
 		});
 
-		if ((secret_string.length()-1) % 8) {
-			error("gtotp secret has a strange length ", secret_string.length()-1);
-			throw Exception();
-		}
+		size_t report_size = 256;
+		for (Secret *s = secrets.first(); s; s = s->next())
+			report_size += s->report_size();
 
-		char const *b32str = secret_string.string();
+		reporter.construct(env, "otp", "otp", report_size);
+		reporter->enabled(true);
 
-		uint8_t buf[8];
-		size_t j = 0;
-		while (j < secret_string.length()-1) {
-			for (size_t k = 0; k < 8; ++k)
-				buf[k] = base32_table[(uint8_t)b32str[j+k]];
+		if (!secrets.first()) {
+			warning("no secrets configured");
+			update_timeout.discard();
+			return;
+		}
 
-			binsec[i+0] = buf[0]<<3 | buf[1]>>2;
-			binsec[i+1] = buf[1]<<6 | buf[2]<<1 | buf[3] >>4;
-			binsec[i+2] = buf[3]<<4 | buf[4]>>1;
-			binsec[i+3] = buf[4]<<7 | buf[5]<<2 | buf[6]>>3;
-			binsec[i+4] = buf[6]<<5 | buf[7];
+		update(Duration(Microseconds(0)));
+	}
 
-			i += 5;
-			j += 8;
-		}
+	Main(Env &env) : env(env)
+	{
+		config_rom.sigh(config_handler);
+		handle_config();
 	}
+};
+
 
-	static Main inst(env, binsec, i);
+void Libc::Component::construct(Libc::Env &env)
+{
+	static Gtotp::Main inst(env);
 };
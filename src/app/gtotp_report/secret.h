@@ -0,0 +1,309 @@
+/*
+ * \brief  Shared secret of a time-based one-time password
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+#ifndef _GTOTP_REPORT__SECRET_H_
+#define _GTOTP_REPORT__SECRET_H_
+
+/* Genode includes */
+#include <util/xml_generator.h>
+#include <util/string.h>
+#include <util/list.h>
+#include <base/allocator.h>
+
+/* Crypto++ includes */
+#include <hmac.h>
+#include <sha.h>
+
+namespace Gtotp {
+
+	using namespace Genode;
+
+	typedef Genode::uint64_t uint64_t;
+	typedef Genode::uint32_t uint32_t;
+	typedef Genode::uint8_t  uint8_t;
+
+	enum { MAX_KEY_LEN = 64, MAX_WINDOW = 16 };
+
+	typedef String<64>  Name;
+	typedef String<16>  Algorithm;
+	typedef String<16>  Code;
+	typedef String<MAX_KEY_LEN*8/5 + 8 + 1> Base32;
+
+	struct Key
+	{
+		uint8_t bytes[MAX_KEY_LEN];
+		size_t  len;
+	};
+
+	static inline bool base32_decode(Base32 const &, Key &);
+
+	class Secret;
+	template <typename> class Hmac_secret;
+}
+
+
+/**
+ * Decode RFC 4648 base32, padding and case are ignored
+ *
+ * \return false if the string contains invalid characters or does not
+ *         fit the key
+ */
+static inline bool Gtotp::base32_decode(Base32 const &string, Key &key)
+{
+	uint32_t bits  = 0;
+	unsigned count = 0;
+
+	key.len = 0;
+
+	for (char const *s = string.string(); *s; s++) {
+		char const c = *s;
+		unsigned v;
+
+		if      (c >= 'A' && c <= 'Z') v = c - 'A';
+		else if (c >= 'a' && c <= 'z') v = c - 'a';
+		else if (c >= '2' && c <= '7') v = c - '2' + 26;
+		else if (c == '=')             break;
+		else                           return false;
+
+		bits   = (bits << 5) | v;
+		count += 5;
+
+		if (count >= 8) {
+			if (key.len == MAX_KEY_LEN)
+				return false;
+
+			count -= 8;
+			key.bytes[key.len++] = (uint8_t)(bits >> count);
+		}
+	}
+	return key.len > 0;
+}
+
+
+/**
+ * Secret with a window of precomputed codes
+ *
+ * The codes of the counters [counter - window, counter + window] are
+ * kept in a ring indexed by the counter modulo the ring size. When the
+ * counter advances, only the codes that enter the window are computed.
+ */
+class Gtotp::Secret : public List<Secret>::Element
+{
+	private:
+
+		Name      const _name;
+		Algorithm const _algorithm;
+		unsigned  const _period;
+		unsigned  const _digits;
+		unsigned  const _window;
+
+		uint32_t _modulo = 1;
+
+		uint32_t _codes[2*MAX_WINDOW + 1];
+
+		/* range of counters with valid codes, empty if '_first > _last' */
+		uint64_t _first = 1;
+		uint64_t _last  = 0;
+		uint64_t _counter = 0;
+
+		unsigned _ring_size() const { return 2*_window + 1; }
+
+		uint32_t &_code(uint64_t counter) {
+			return _codes[counter % _ring_size()]; }
+
+		uint32_t _compute(uint64_t counter)
+		{
+			CryptoPP::MessageAuthenticationCode &hmac = _mac();
+
+			uint8_t msg[8];
+			for (unsigned i = 0; i < 8; i++)
+				msg[i] = counter >> ((7 - i) * 8) & 0xff;
+
+			uint8_t digest[CryptoPP::SHA512::DIGESTSIZE];
+
+			hmac.Update(msg, sizeof(msg));
+			hmac.Final(digest);
+			hmac.Restart();
+
+			/* dynamic truncation of RFC 4226 */
+			unsigned const offset = digest[hmac.DigestSize() - 1] & 0x0F;
+
+			uint32_t const code = (digest[offset + 0] & 0x7F) << (3 * 8)
+			                    |  digest[offset + 1]         << (2 * 8)
+			                    |  digest[offset + 2]         << (1 * 8)
+			                    |  digest[offset + 3]         << (0 * 8);
+
+			return code % _modulo;
+		}
+
+		Code _format(uint32_t code) const
+		{
+			char buf[Code::capacity()];
+			for (unsigned i = _digits; i > 0; i--, code /= 10)
+				buf[i - 1] = '0' + code % 10;
+			buf[_digits] = 0;
+			return Code((char const *)buf);
+		}
+
+		/*
+		 * Noncopyable
+		 */
+		Secret(Secret const &);
+		Secret &operator = (Secret const &);
+
+	protected:
+
+		virtual CryptoPP::MessageAuthenticationCode &_mac() = 0;
+
+	public:
+
+		Secret(Name const &name, Algorithm const &algorithm,
+		       unsigned period, unsigned digits, unsigned window)
+		:
+			_name(name), _algorithm(algorithm),
+			_period(period), _digits(digits), _window(window)
+		{
+			for (unsigned i = 0; i < _digits; i++)
+				_modulo *= 10;
+		}
+
+		virtual ~Secret() { }
+
+		/**
+		 * Return true if the algorithm name is supported
+		 */
+		static bool supported(Algorithm const &algorithm)
+		{
+			return algorithm == "sha1" || algorithm == "sha256"
+			    || algorithm == "sha512";
+		}
+
+		/**
+		 * Create secret for the given algorithm
+		 */
+		static Secret *create(Allocator &alloc, Name const &name,
+		                      Algorithm const &algorithm, Key const &key,
+		                      unsigned period, unsigned digits,
+		                      unsigned window);
+
+		unsigned period() const { return _period; }
+
+		Name const &name() const { return _name; }
+
+		/**
+		 * Update the codes for the given time
+		 *
+		 * \return true if the current code changed
+		 */
+		bool update(uint64_t seconds)
+		{
+			uint64_t const counter = seconds / _period;
+
+			if (_first <= _last && counter == _counter)
+				return false;
+
+			uint64_t const first = counter > _window ? counter - _window : 0;
+			uint64_t const last  = counter + _window;
+
+			for (uint64_t c = first; c <= last; c++)
+				if (c < _first || c > _last)
+					_code(c) = _compute(c);
+
+			_first   = first;
+			_last    = last;
+			_counter = counter;
+			return true;
+		}
+
+		/**
+		 * Return time in seconds at which the current code expires
+		 */
+		uint64_t expires() const { return (_counter + 1)*_period; }
+
+		/**
+		 * Return code of the current period
+		 */
+		Code value() { return _format(_code(_counter)); }
+
+		/**
+		 * Return upper bound of the size of the report of one secret
+		 */
+		size_t report_size() const { return 256 + 2*_window*48; }
+
+		void report(Xml_generator &xml)
+		{
+			xml.node("secret", [&] () {
+				xml.attribute("name",      _name.string());
+				xml.attribute("algorithm", _algorithm.string());
+				xml.attribute("period",    _period);
+				xml.attribute("digits",    _digits);
+				xml.attribute("counter",   _counter);
+				xml.attribute("expires",   expires());
+
+				xml.attribute("value",     value().string());
+
+				for (uint64_t c = _first; c <= _last; c++) {
+					if (c == _counter)
+						continue;
+
+					xml.node("code", [&] () {
+						xml.attribute("offset", (long long)c - (long long)_counter);
+						xml.attribute("value",  _format(_code(c)).string());
+					});
+				}
+			});
+		}
+};
+
+
+template <typename HASH>
+class Gtotp::Hmac_secret : public Secret
+{
+	private:
+
+		CryptoPP::HMAC<HASH> _hmac;
+
+	protected:
+
+		CryptoPP::MessageAuthenticationCode &_mac() override { return _hmac; }
+
+	public:
+
+		Hmac_secret(Name const &name, Algorithm const &algorithm,
+		            Key const &key, unsigned period, unsigned digits,
+		            unsigned window)
+		:
+			Secret(name, algorithm, period, digits, window),
+			_hmac(key.bytes, key.len)
+		{ }
+};
+
+
+inline Gtotp::Secret *
+Gtotp::Secret::create(Allocator &alloc, Name const &name,
+                      Algorithm const &algorithm, Key const &key,
+                      unsigned period, unsigned digits, unsigned window)
+{
+	if (algorithm == "sha256")
+		return new (alloc) Hmac_secret<CryptoPP::SHA256>(
+			name, algorithm, key, period, digits, window);
+
+	if (algorithm == "sha512")
+		return new (alloc) Hmac_secret<CryptoPP::SHA512>(
+			name, algorithm, key, period, digits, window);
+
+	return new (alloc) Hmac_secret<CryptoPP::SHA1>(
+		name, algorithm, key, period, digits, window);
+}
+
+#endif /* _GTOTP_REPORT__SECRET_H_ */
@@ -22,7 +22,9 @@
 #include <base/sleep.h>
 #include <base/log.h>
 #include <base/component.h>
+#include <util/list.h>
 #include <util/xml_generator.h>
+#include <timer_session/connection.h>
 
 namespace Xml_editor {
 	using namespace Genode;
@@ -31,6 +33,7 @@ namespace Xml_editor {
 	typedef Genode::String<64> Name;
 
 	struct Xml_file;
+	struct Commit_pipeline;
 	struct Report_session_component;
 	class Report_root_component;
 	struct Main;
@@ -40,8 +43,28 @@ namespace Xml_editor {
 
 Genode::Env *_env;
 
+/**
+ * XML document that is edited in place
+ *
+ * The document is kept in a canonical layout with one top-level node per
+ * line and a fixed-width revision attribute. Named top-level nodes are
+ * indexed by type and name, so that an edit is applied as a splice of the
+ * affected bytes instead of regenerating the document. Added nodes are
+ * appended in front of the closing tag, removed nodes are blanked out.
+ * Only the changed byte ranges are written back to the file and the
+ * blanks left by removals are compacted once they dominate the document.
+ */
 struct Xml_editor::Xml_file
 {
+	enum {
+		BUCKET_COUNT = 256,
+		REV_DIGITS   = 10,
+		MAX_DIRTY    = 8,
+		MIN_COMPACT  = 4096,
+	};
+
+	typedef Genode::String<64> Type;
+
 	Genode::Allocator &alloc;
 	Vfs::Vfs_handle   &vfs_handle;
 
@@ -49,50 +72,221 @@ struct Xml_editor::Xml_file
 	unsigned revision = 0;
 
 
-	/*****************************
-	 ** Current and next buffer **
-	 *****************************/
+	/************
+	 ** Buffer **
+	 ************/
+
+	struct Buffer
+	{
+		Genode::Allocator &alloc;
+
+		char  *ptr      = nullptr;
+		size_t capacity = 0;
+		size_t used     = 0;
+
+		Buffer(Genode::Allocator &alloc) : alloc(alloc) { }
+
+		~Buffer()
+		{
+			if (ptr)
+				alloc.free(ptr, capacity);
+		}
+
+		void reserve(size_t min_size)
+		{
+			if (capacity >= min_size)
+				return;
+
+			size_t const new_capacity = max(min_size, max(capacity*2, (size_t)4096));
+			char * const new_ptr = (char *)alloc.alloc(new_capacity);
+			if (ptr) {
+				memcpy(new_ptr, ptr, used);
+				alloc.free(ptr, capacity);
+			}
+			ptr      = new_ptr;
+			capacity = new_capacity;
+		}
+
+		void append(char const *src, size_t len)
+		{
+			reserve(used + len);
+			memcpy(ptr + used, src, len);
+			used += len;
+		}
+
+		void append(char const *str) { append(str, strlen(str)); }
 
-	struct Buffer {
-		char *ptr = nullptr;
-		size_t size = 0;
-		Buffer *next;
+		void swap(Buffer &other)
+		{
+			char  *p = ptr;      ptr      = other.ptr;      other.ptr      = p;
+			size_t c = capacity; capacity = other.capacity; other.capacity = c;
+			size_t u = used;     used     = other.used;     other.used     = u;
+		}
+
+		private:
+
+			/*
+			 * Noncopyable
+			 */
+			Buffer(Buffer const &);
+			Buffer &operator = (Buffer const &);
 	};
 
-	Buffer yin;
-	Buffer yang;
+	Buffer buffer { alloc };
 
-	Buffer *buffer = &yin;
+	size_t rev_offset = 0; /* position of the revision digits */
+	size_t body_end   = 0; /* position of the closing tag */
+	size_t slack      = 0; /* bytes blanked out by removals */
 
-	Buffer &next_buffer() { return *buffer->next; }
+	Vfs::file_size written_size = 0;
+
+
+	/****************
+	 ** Node index **
+	 ****************/
+
+	struct Entry : List<Entry>::Element
+	{
+		Type     const type;
+		Name     const name;
+		unsigned const hash;
+
+		size_t offset;
+		size_t length;
+
+		Entry(Type const &type, Name const &name, unsigned hash,
+		      size_t offset, size_t length)
+		:
+			type(type), name(name), hash(hash), offset(offset), length(length)
+		{ }
+	};
+
+	List<Entry> buckets[BUCKET_COUNT];
+
+	static unsigned hash(Type const &type, Name const &name)
+	{
+		/* FNV-1a over type and name */
+		unsigned h = 2166136261U;
+		for (char const *s = type.string(); *s; s++)
+			h = (h ^ (unsigned char)*s) * 16777619U;
+		h = (h ^ '/') * 16777619U;
+		for (char const *s = name.string(); *s; s++)
+			h = (h ^ (unsigned char)*s) * 16777619U;
+		return h;
+	}
+
+	List<Entry> &bucket(unsigned hash) { return buckets[hash % BUCKET_COUNT]; }
+
+	Entry *lookup(Type const &type, Name const &name)
+	{
+		unsigned const h = hash(type, name);
+		for (Entry *e = bucket(h).first(); e; e = e->next())
+			if (e->hash == h && e->type == type && e->name == name)
+				return e;
+		return nullptr;
+	}
+
+	void index(Type const &type, Name const &name, size_t offset, size_t length)
+	{
+		unsigned const h = hash(type, name);
+		bucket(h).insert(new (alloc) Entry(type, name, h, offset, length));
+	}
+
+	void unindex(Entry &e)
+	{
+		bucket(e.hash).remove(&e);
+		destroy(alloc, &e);
+	}
+
+	void clear_index()
+	{
+		for (unsigned i = 0; i < BUCKET_COUNT; i++)
+			while (Entry *e = buckets[i].first())
+				unindex(*e);
+	}
+
+	/*
+	 * Only named nodes are indexed, unnamed nodes are not unique and are
+	 * looked up by scanning the document.
+	 */
+	void reindex()
+	{
+		clear_index();
+
+		xml().for_each_sub_node([&] (Xml_node const &node) {
+			Name const name = node.attribute_value("name", Name());
+			if (name.valid())
+				index(node.type(), name, node.addr() - buffer.ptr, node.size());
+		});
+	}
 
 	/**
-	 * Return the next buffer, zeroed, and reallocated
-	 * if necessary
+	 * Call 'fn' with offset and length of the last unnamed node of 'type'
+	 *
+	 * \return false if there is no such node
 	 */
-	Buffer &next_buffer(size_t min_size)
-	{
-		Buffer &next = *buffer->next;
-		if (next.size < min_size) {
-			if (next.ptr)
-				alloc.free(next.ptr, next.size);
-			next.ptr = (char *)alloc.alloc(min_size);
-			next.size = min_size;
-		}
-		memset(next.ptr, 0x00, next.size);
-		return next;
+	template <typename FN>
+	bool with_last_unnamed(Type const &type, FN const &fn)
+	{
+		bool   found  = false;
+		size_t offset = 0, length = 0;
+
+		xml().for_each_sub_node(type.string(), [&] (Xml_node const &node) {
+			if (node.has_attribute("name"))
+				return;
+			found  = true;
+			offset = node.addr() - buffer.ptr;
+			length = node.size();
+		});
+
+		if (found)
+			fn(offset, length);
+		return found;
 	}
 
-	template<typename FUNC>
-	Xml_generator generate(char const *type, size_t min_size, FUNC const &fn)
+
+	/*******************
+	 ** Dirty regions **
+	 *******************/
+
+	struct Range { size_t from, to; };
+
+	Range    dirty_ranges[MAX_DIRTY];
+	unsigned dirty_count = 0;
+	bool     dirty_all   = false;
+
+	void dirty(size_t from, size_t to)
 	{
-		Buffer &next = next_buffer(min_size);
+		for (unsigned i = 0; i < dirty_count; i++) {
+			Range &r = dirty_ranges[i];
+			if (from <= r.to && to >= r.from) {
+				r.from = min(r.from, from);
+				r.to   = max(r.to, to);
+				return;
+			}
+		}
 
-		return Xml_generator(next.ptr, next.size, type, fn);
+		/* collapse into one range if out of slots */
+		if (dirty_count == MAX_DIRTY) {
+			for (unsigned i = 1; i < dirty_count; i++) {
+				dirty_ranges[0].from = min(dirty_ranges[0].from, dirty_ranges[i].from);
+				dirty_ranges[0].to   = max(dirty_ranges[0].to,   dirty_ranges[i].to);
+			}
+			dirty_count = 1;
+			dirty_ranges[0].from = min(dirty_ranges[0].from, from);
+			dirty_ranges[0].to   = max(dirty_ranges[0].to,   to);
+			return;
+		}
+
+		dirty_ranges[dirty_count++] = Range { from, to };
 	}
 
-	Xml_node xml() const {
-		return Xml_node(buffer->ptr, buffer->size); }
+	bool modified() const { return dirty_all || dirty_count; }
+
+
+	/**************
+	 ** File I/O **
+	 **************/
 
 	/**
 	 * Flush file changes
@@ -111,229 +305,527 @@ struct Xml_editor::Xml_file
 		}
 	}
 
-	void read_file()
+	void read_file(Buffer &out)
 	{
 		using namespace Vfs;
 
 		Directory_service::Stat sb;
 		vfs_handle.ds().stat(path.base(), sb);
 		file_size const total = sb.size;
-
-		Buffer &next = next_buffer(total ? total : 4096);
-		buffer = &next;
+		written_size = total;
 
 		if (total == 0) {
-			strncpy(next.ptr, "<config/>", next.size);
-		} else {
-			/*
-			 * Read in one pass, reading in multiple passes is
-			 * too complicated and error prone
-			 */
-			file_size out = 0;
-			while (!vfs_handle.fs().queue_read(&vfs_handle, total))
-				_env->ep().wait_and_dispatch_one_io_signal();
+			out.append("<config/>");
+			return;
+		}
 
-			for (;;) {
-				auto r = vfs_handle.fs().complete_read(
-					&vfs_handle, next.ptr, total, out);
-				switch (r) {
-				case Vfs::File_io_service::Read_result::READ_QUEUED:
-					_env->ep().wait_and_dispatch_one_io_signal();
-					break;
-				case Vfs::File_io_service::Read_result::READ_OK:
-					return;
-				default:
-					Genode::error("failed to read XML file");
-					throw r;
-				}
+		out.reserve(total);
+
+		/*
+		 * Read in one pass, reading in multiple passes is
+		 * too complicated and error prone
+		 */
+		Vfs::file_size n = 0;
+		vfs_handle.seek(0);
+		while (!vfs_handle.fs().queue_read(&vfs_handle, total))
+			_env->ep().wait_and_dispatch_one_io_signal();
+
+		for (;;) {
+			auto r = vfs_handle.fs().complete_read(
+				&vfs_handle, out.ptr, total, n);
+			switch (r) {
+			case Vfs::File_io_service::Read_result::READ_QUEUED:
+				_env->ep().wait_and_dispatch_one_io_signal();
+				break;
+			case Vfs::File_io_service::Read_result::READ_OK:
+				out.used = n;
+				return;
+			default:
+				Genode::error("failed to read XML file");
+				throw r;
 			}
 		}
 	}
 
-	void write_file(Vfs::file_size length)
+	void write_range(size_t from, size_t to)
 	{
-		using namespace Vfs;
-
-		Buffer &next = next_buffer();
+		to = min(to, buffer.used);
 
-		vfs_handle.fs().ftruncate(&vfs_handle, length);
-
-		file_size offset = 0;
-		while (offset < length) {
+		Vfs::file_size offset = from;
+		while (offset < to) {
 			vfs_handle.seek(offset);
-			file_size n = 0;
-			vfs_handle.fs().write(
-				&vfs_handle,
-				next.ptr + offset,
-				length - offset,
-				n);
+			Vfs::file_size n = 0;
+			vfs_handle.fs().write(&vfs_handle, buffer.ptr + offset, to - offset, n);
+			if (n == 0) {
+				error("failed to write '", path, "'");
+				return;
+			}
 			offset += n;
 		}
+	}
+
+	/**
+	 * Write back the modified ranges of the document and sync the file
+	 */
+	void write_file()
+	{
+		if (!modified())
+			return;
+
+		if (slack > MIN_COMPACT && slack > buffer.used/2)
+			compact();
+
+		if (dirty_all) {
+			write_range(0, buffer.used);
+		} else {
+			for (unsigned i = 0; i < dirty_count; i++)
+				write_range(dirty_ranges[i].from, dirty_ranges[i].to);
+		}
+
+		if (buffer.used < written_size)
+			vfs_handle.fs().ftruncate(&vfs_handle, buffer.used);
 
-		buffer = &next;
+		written_size = buffer.used;
+		dirty_count  = 0;
+		dirty_all    = false;
+
+		sync();
 	}
 
+
+	/*********************
+	 ** Document layout **
+	 *********************/
+
+	/**
+	 * Generate the canonical layout of 'doc' into 'out'
+	 */
+	void build(Xml_node const &doc, Buffer &out)
+	{
+		Type const type = doc.type();
+
+		out.append("<");
+		out.append(type.string());
+
+		try {
+			Xml_attribute attr = doc.attribute(0U);
+			while (true) {
+				auto attr_name = attr.name();
+				if (attr_name != REVISION_ATTR_NAME) {
+					Genode::String<256> data;
+					attr.value(&data);
+					out.append(" ");
+					out.append(attr_name.string());
+					out.append("=\"");
+					out.append(data.string());
+					out.append("\"");
+				}
+				attr = attr.next();
+			}
+		} catch (Xml_node::Nonexistent_attribute) { }
+
+		/* the revision is rewritten in place and thus has a fixed width */
+		out.append(" " REVISION_ATTR_NAME "=\"");
+		rev_offset = out.used;
+		for (unsigned i = 0; i < REV_DIGITS; i++)
+			out.append("0");
+		out.append("\">\n");
+
+		doc.for_each_sub_node([&] (Xml_node const &node) {
+			out.append(node.addr(), node.size());
+			out.append("\n");
+		});
+
+		body_end = out.used;
+		out.append("</");
+		out.append(type.string());
+		out.append(">\n");
+	}
+
+	void write_revision()
+	{
+		unsigned v = revision;
+		for (unsigned i = REV_DIGITS; i > 0; i--, v /= 10)
+			buffer.ptr[rev_offset + i - 1] = '0' + v % 10;
+
+		dirty(rev_offset, rev_offset + REV_DIGITS);
+	}
+
+	/**
+	 * Drop the blanks left by removed nodes
+	 */
+	void compact()
+	{
+		Buffer compacted { alloc };
+		build(xml(), compacted);
+		buffer.swap(compacted);
+
+		write_revision();
+		reindex();
+
+		slack       = 0;
+		dirty_count = 0;
+		dirty_all   = true;
+	}
+
+	Xml_node xml() const {
+		return Xml_node(buffer.ptr, buffer.used); }
+
 	Xml_file(Genode::Allocator &alloc,
 	         Vfs::Vfs_handle &handle,
 	         Path const &path)
 	:
 		alloc(alloc), vfs_handle(handle), path(path)
 	{
-		yin.next = &yang;
-		yang.next = &yin;
-
-		read_file();
+		Buffer raw { alloc };
+		read_file(raw);
 
 		try {
-			Xml_node const editor_node = xml().sub_node("xml_editor");
-			revision = editor_node.attribute_value("rev", 0U);
+			Xml_node const doc(raw.ptr, raw.used);
+
+			revision = doc.attribute_value(REVISION_ATTR_NAME, 0U);
+			if (doc.has_sub_node("xml_editor"))
+				revision = doc.sub_node("xml_editor").attribute_value("rev", revision);
+
+			build(doc, buffer);
 		}
-		catch (Xml_node::Nonexistent_sub_node) { }
 		catch (Xml_node::Invalid_syntax) {
-			Genode::error("invalid XML at '", path, "'");
+			Genode::error("invalid XML at '", path, "', starting with empty document");
+			build(Xml_node("<config/>"), buffer);
 		}
+
+		write_revision();
+		reindex();
+
+		/* the first write replaces the file by the canonical layout */
+		dirty_count = 0;
+		dirty_all   = true;
 	}
 
-	~Xml_file()
+	~Xml_file() { clear_index(); }
+
+
+	/***********
+	 ** Edits **
+	 ***********/
+
+	void bump_revision()
 	{
-		if (yin.ptr)
-			alloc.free(yin.ptr, yin.size);
-		if (yang.ptr)
-			alloc.free(yang.ptr, yang.size);
+		++revision;
+		write_revision();
 	}
 
-	size_t add(Xml_node const &new_node)
+	bool add(Xml_node const &new_node)
 	{
-		Xml_node const current = xml();
+		Type const type = new_node.type();
+		Name const name = new_node.attribute_value("name", Name());
 
-		Name const new_name =
-			new_node.attribute_value("name", Name());
+		/* unnamed nodes may occur any number of times */
+		if (name.valid() && lookup(type, name)) {
+			error(name, " ", type, " node already present in config");
+			return false;
+		}
 
-		current.for_each_sub_node(new_node.type().string(),
-		                          [&] (Xml_node const &existing_start) {
-			if (existing_start.attribute_value("name", Name()) == new_name) {
-				error(new_name, " start node already present in config");
-			}
-		});
+		size_t const len       = new_node.size();
+		size_t const close_len = buffer.used - body_end;
 
+		/* move the closing tag behind the new node */
+		buffer.reserve(buffer.used + len + 1);
+		memmove(buffer.ptr + body_end + len + 1, buffer.ptr + body_end, close_len);
+		memcpy(buffer.ptr + body_end, new_node.addr(), len);
+		buffer.ptr[body_end + len] = '\n';
 
-		Xml_generator gen = generate(current.type().string(),
-		                             current.size()+new_node.size()*2,
-		                             [&] () {
-			try {
-				Xml_attribute attr = current.attribute(0U);
-				while (true) {
-					auto attr_name = attr.name();
-					if (attr_name != REVISION_ATTR_NAME) {
-						Genode::String<256> data;
-						attr.value(&data);
-						gen.attribute(attr_name.string(), data.string());
-					}
-					attr = attr.next();
-				}
-			} catch (Xml_node::Nonexistent_attribute) { }
+		if (name.valid())
+			index(type, name, body_end, len);
 
-			/* set revision info as a top-level attribute */
-			gen.attribute("edit_rev", ++revision);
+		buffer.used += len + 1;
+		dirty(body_end, buffer.used);
+		body_end += len + 1;
 
-			/* add new content node */
-			gen.append(new_node.addr(), new_node.size());
+		bump_revision();
+		return true;
+	}
 
-			try {
-				/* add existing nodes */
-				Xml_node node = current.sub_node();
-				while (true) {
-					gen.append(node.addr(), node.size());
-					node = node.next();
-				}
+	/**
+	 * Remove the node at 'offset' from the buffer
+	 */
+	void cut(size_t offset, size_t len)
+	{
+		if (offset + len + 1 == body_end) {
+
+			/* the last node is cut off together with the file */
+			size_t const close_len = buffer.used - body_end;
+			memmove(buffer.ptr + offset, buffer.ptr + body_end, close_len);
+			body_end     = offset;
+			buffer.used  = offset + close_len;
+			dirty(offset, buffer.used);
+
+		} else {
 
-			} catch (Xml_node::Nonexistent_sub_node) {
+			/* leave a blank to keep the offsets of the other nodes */
+			memset(buffer.ptr + offset, ' ', len);
+			dirty(offset, offset + len);
+			slack += len;
+		}
+	}
+
+	/**
+	 * Remove all nodes of the type and name of 'node'
+	 *
+	 * An unnamed node removes all unnamed nodes of its type. These are
+	 * removed from the end so that nodes at the end of the document are
+	 * cut off instead of blanked.
+	 */
+	bool remove(Xml_node const &node)
+	{
+		Type const type = node.type();
+		Name const name = node.attribute_value("name", Name());
+
+		bool removed = false;
+
+		if (name.valid()) {
+			while (Entry *e = lookup(type, name)) {
+				size_t const offset = e->offset;
+				size_t const len    = e->length;
+				unindex(*e);
+				cut(offset, len);
+				removed = true;
 			}
-			gen.append("\n");
-		});
+		} else {
+			while (with_last_unnamed(type, [&] (size_t offset, size_t len) {
+				cut(offset, len); }))
+				removed = true;
+		}
 
-		return gen.used();
+		if (removed)
+			bump_revision();
+		return removed;
 	}
 
-	size_t remove(Xml_node const &node)
+	bool contains(Xml_node const &node)
 	{
-		Name const remove_name =
-			node.attribute_value("name", Name());
+		Name const name = node.attribute_value("name", Name());
 
-		Xml_node const current = xml();
+		if (name.valid())
+			return lookup(node.type(), name) != nullptr;
 
-		Xml_generator gen = generate(current.type().string(),
-		                             current.size()*4,
-		                             [&] () {
-			try {
-				Xml_attribute attr = current.attribute(0U);
-				while (true) {
-					auto attr_name = attr.name();
-					if (attr_name != REVISION_ATTR_NAME) {
-						Genode::String<256> data;
-						attr.value(&data);
-						gen.attribute(attr_name.string(), data.string());
-					}
-					attr = attr.next();
-				}
-			} catch (Xml_node::Nonexistent_attribute) { }
-
-			/* set revision info as a top-level attribute */
-			gen.attribute("edit_rev", ++revision);
-
-			current.for_each_sub_node([&] (Xml_node const &node) {
-				/* skip the node we are removing */
-				auto name = node.attribute_value("name", Name());
-				if (name != remove_name)
-				{
-					gen.append(node.addr(), node.size());
-					gen.append("\n");
-				}
-			});
-			gen.append("\n");
-		});
+		return with_last_unnamed(node.type(), [] (size_t, size_t) { });
+	}
 
-		return gen.used();
+	bool toggle(Xml_node const &node)
+	{
+		return contains(node) ? remove(node) : add(node);
 	}
+};
+
 
-	size_t toggle(Xml_node const &node)
+/**
+ * Merges the actions received within the commit window into one write
+ *
+ * Edits are applied to the document immediately, but the file is only
+ * written and synced once the window expired. Without a window, the
+ * commit is deferred to a local signal, which merges all reports that
+ * are queued at the entrypoint.
+ */
+struct Xml_editor::Commit_pipeline
+{
+	struct Commit
 	{
-		Name const toggle_name = node.attribute_value("name", Name());
-		Xml_node const current = xml();
-		bool name_present = false;
+		unsigned revision;
+		unsigned actions;
+	};
 
-		current.for_each_sub_node([&] (Xml_node const &other) {
-			if (!name_present &&
-			    other.type() == node.type() &&
-			    toggle_name == other.attribute_value("name", Name()))
-			{
-				name_present = true;
-			}
-		});
+	struct Client : List<Client>::Element
+	{
+		unsigned pending = 0;
+
+		virtual void committed(Commit const &) = 0;
+	};
+
+	Xml_file &file;
+
+	List<Client> clients { };
+
+	unsigned actions   = 0;
+	bool     scheduled = false;
+
+	Microseconds const window;
+
+	/* only needed for a commit window */
+	Constructible<Timer::Connection> timer { };
+
+	Constructible<Timer::One_shot_timeout<Commit_pipeline>> timeout { };
+
+	Signal_handler<Commit_pipeline> commit_handler;
+
+	void commit()
+	{
+		if (!scheduled)
+			return;
+
+		scheduled = false;
+
+		file.write_file();
+
+		Commit const commit { file.revision, actions };
+		actions = 0;
+
+		for (Client *c = clients.first(); c; c = c->next()) {
+			if (!c->pending)
+				continue;
+
+			c->pending = 0;
+			c->committed(commit);
+		}
+	}
+
+	void handle_timeout(Duration) { commit(); }
+
+	Commit_pipeline(Genode::Env &env, Xml_file &file, unsigned window_ms)
+	:
+		file(file), window(Microseconds { window_ms*1000UL }),
+		commit_handler(env.ep(), *this, &Commit_pipeline::commit)
+	{
+		if (window.value) {
+			timer.construct(env);
+			timeout.construct(*timer, *this, &Commit_pipeline::handle_timeout);
+		}
+	}
 
-		return name_present ? remove(node) : add(node);
+	/**
+	 * Account actions of a client that are already applied to the document
+	 */
+	void queued(Client &client, unsigned n)
+	{
+		client.pending += n;
+		actions        += n;
+
+		if (scheduled)
+			return;
+
+		scheduled = true;
+
+		if (timeout.constructed())
+			timeout->schedule(window);
+		else
+			Signal_transmitter(commit_handler).submit();
 	}
 };
 
 
-struct Xml_editor::Report_session_component : Genode::Rpc_object<Report::Session>
+struct Xml_editor::Report_session_component : Genode::Rpc_object<Report::Session>,
+                                              Commit_pipeline::Client
 {
+	enum { MAX_RESULTS = 32 };
+
+	enum Status { OK, EXISTS, MISSING, CONFLICT };
+
+	static char const *status_name(Status status)
+	{
+		switch (status) {
+		case OK:       return "ok";
+		case EXISTS:   return "exists";
+		case MISSING:  return "missing";
+		case CONFLICT: return "conflict";
+		}
+		return "";
+	}
+
+	/**
+	 * Outcome of one action
+	 */
+	struct Result
+	{
+		char const     *action; /* static string */
+		Xml_file::Type  type;
+		Name            name;
+		Status          status;
+		unsigned        revision;
+	};
+
+	/**
+	 * Results of the actions that belong to one commit
+	 */
+	struct Results
+	{
+		Result   results[MAX_RESULTS];
+		unsigned count   = 0;
+		unsigned dropped = 0;
+
+		void add(Result const &result)
+		{
+			if (count < MAX_RESULTS)
+				results[count++] = result;
+			else
+				dropped++;
+		}
+
+		void reset() { count = dropped = 0; }
+	};
+
 	Session_label const label;
 
 	Attached_ram_dataspace ram_ds;
 
 	Xml_file &xml_file;
 
+	Commit_pipeline &pipeline;
+
+	Signal_context_capability response_sigh_cap { };
+
+	Results pending_results   { };
+	Results committed_results { };
+
+	Constructible<Commit_pipeline::Commit> last_commit { };
+
 	bool const verbose = true;
 
 	Report_session_component(Genode::Env &env, size_t buffer_size,
-	                         Xml_file &file,
+	                         Commit_pipeline &pipeline,
 	                         Session_label const &session_label)
 	:
 		label(session_label),
 		ram_ds(env.ram(), env.rm(), buffer_size),
-		xml_file(file)
-	{ }
+		xml_file(pipeline.file), pipeline(pipeline)
+	{
+		pipeline.clients.insert(this);
+	}
+
+	~Report_session_component() { pipeline.clients.remove(this); }
+
+	void committed(Commit_pipeline::Commit const &commit) override
+	{
+		last_commit.construct(commit);
+
+		committed_results = pending_results;
+		pending_results.reset();
+
+		if (response_sigh_cap.valid())
+			Signal_transmitter(response_sigh_cap).submit();
+	}
+
+	void generate_response(Xml_generator &xml, bool with_results)
+	{
+		xml.attribute("rev",     last_commit->revision);
+		xml.attribute("actions", last_commit->actions);
+
+		if (!with_results)
+			return;
+
+		if (committed_results.dropped)
+			xml.attribute("dropped", committed_results.dropped);
+
+		for (unsigned i = 0; i < committed_results.count; i++) {
+			Result const &r = committed_results.results[i];
+			xml.node(r.action, [&] () {
+				xml.attribute("type",   r.type);
+				xml.attribute("name",   r.name);
+				xml.attribute("status", status_name(r.status));
+				if (r.status == OK)
+					xml.attribute("rev", r.revision);
+			});
+		}
+	}
 
 
 	/******************************
@@ -343,62 +835,100 @@ struct Xml_editor::Report_session_component : Genode::Rpc_object<Report::Session
 	Dataspace_capability dataspace() override {
 		return ram_ds.cap(); }
 
+	/**
+	 * Apply the actions of a report
+	 *
+	 * If the report carries an 'expected_rev' attribute, its actions are
+	 * only applied if the document is still at the expected revision.
+	 * Otherwise, all actions fail with the status "conflict".
+	 */
 	void submit(size_t length) override
 	{
-		size_t content_size = 0;
+		unsigned actions = 0;
+		bool     conflict = false;
+
+		auto apply = [&] (char const *action, Xml_node const &subnode, bool present) {
+			Xml_file::Type const type = subnode.type();
+			Name           const name = subnode.attribute_value("name", Name());
+
+			if (verbose)
+				log("'", label, "' ", action, " '", name, "'");
+
+			Status status = CONFLICT;
+			if (!conflict) {
+				bool ok = false;
+				if (!strcmp(action, "add"))    ok = xml_file.add(subnode);
+				if (!strcmp(action, "remove")) ok = xml_file.remove(subnode);
+				if (!strcmp(action, "toggle")) ok = xml_file.toggle(subnode);
+				status = ok ? OK : (present ? EXISTS : MISSING);
+			}
 
-		auto add_fn = [&] (Xml_node const &action) {
-			action.for_each_sub_node([&] (Xml_node const &subnode) {
-				if (verbose)
-					log("'", label, "' adds '", subnode.attribute_value("name", Name()), "'");
-				content_size = xml_file.add(subnode);
-			});
+			pending_results.add(Result { action, type, name, status, xml_file.revision });
+			actions++;
 		};
 
-		auto remove_fn = [&] (Xml_node const &action) {
-			action.for_each_sub_node([&] (Xml_node const &subnode) {
-				if (verbose)
-					log("'", label, "' removes '", subnode.attribute_value("name", Name()), "'");
-				content_size = xml_file.remove(subnode);
-			});
-		};
-
-		auto toggle_fn = [&] (Xml_node const &action) {
-			action.for_each_sub_node([&] (Xml_node const &subnode) {
-				if (verbose)
-					log("'", label, "' toggles '", subnode.attribute_value("name", Name()), "'");
-				content_size = xml_file.toggle(subnode);
-			});
+		auto action_fn = [&] (char const *action) {
+			return [&, action] (Xml_node const &node) {
+				node.for_each_sub_node([&] (Xml_node const &subnode) {
+					apply(action, subnode, xml_file.contains(subnode)); });
+			};
 		};
 
 		try {
 			Xml_node edit_node(ram_ds.local_addr<char const>(), length);
 
-			edit_node.for_each_sub_node("toggle", toggle_fn);
-			edit_node.for_each_sub_node("remove", remove_fn);
-			edit_node.for_each_sub_node("add", add_fn);
-			if (content_size) {
-				xml_file.write_file(content_size);
-				xml_file.sync();
+			if (edit_node.has_attribute("expected_rev")) {
+				unsigned const expected = edit_node.attribute_value("expected_rev", 0U);
+				conflict = expected != xml_file.revision;
+				if (conflict && verbose)
+					log("'", label, "' expected revision ", expected, ", "
+					    "document is at ", xml_file.revision);
 			}
+
+			edit_node.for_each_sub_node("toggle", action_fn("toggle"));
+			edit_node.for_each_sub_node("remove", action_fn("remove"));
+			edit_node.for_each_sub_node("add",    action_fn("add"));
+
+			if (actions)
+				pipeline.queued(*this, actions);
 		} catch (Xml_node::Invalid_syntax) {
 			error("invalid XML received from '", label, "'");
-		} catch (Genode::Xml_generator::Buffer_exceeded) {
-			error("Genode::Xml_generator::Buffer_exceeded");
 		} catch (...) {
 			error("failed to process action from '", label, "'");
 			throw;
 		}
 	}
 
-	void response_sigh(Signal_context_capability) override
-	{
-		warning(__func__, " not implemented");
-	}
+	void response_sigh(Signal_context_capability sigh) override {
+		response_sigh_cap = sigh; }
 
-	size_t obtain_response()
+	/**
+	 * Return the revision of the last commit that included actions of
+	 * this session along with the status of each of these actions
+	 */
+	size_t obtain_response() override
 	{
-		warning(__func__, " not implemented");
+		if (!last_commit.constructed())
+			return 0;
+
+		char * const dst  = ram_ds.local_addr<char>();
+		size_t const size = ram_ds.size();
+
+		try {
+			Xml_generator xml(dst, size, "commit", [&] () {
+				generate_response(xml, true); });
+			return xml.used();
+		}
+		catch (Xml_generator::Buffer_exceeded) { }
+
+		/* the results do not fit into the report buffer */
+		try {
+			Xml_generator xml(dst, size, "commit", [&] () {
+				generate_response(xml, false); });
+			return xml.used();
+		}
+		catch (Xml_generator::Buffer_exceeded) { }
+
 		return 0;
 	}
 };
@@ -413,7 +943,7 @@ class Xml_editor::Report_root_component :
 
 		Attached_rom_dataspace &_config;
 
-		Xml_file &_xml_file;
+		Commit_pipeline &_pipeline;
 
 	protected:
 
@@ -446,7 +976,7 @@ class Xml_editor::Report_root_component :
 			try {
 			return new (md_alloc())
 				Xml_editor::Report_session_component(
-					_env, buffer_size, _xml_file, label);
+					_env, buffer_size, _pipeline, label);
 			}
 			catch (Out_of_ram)             { error("Out_of_ram"); }
 			catch (Out_of_caps)            { error("Out_of_caps"); }
@@ -461,10 +991,10 @@ class Xml_editor::Report_root_component :
 		Report_root_component(Genode::Env &env,
 		                      Genode::Allocator &md_alloc,
 		                      Attached_rom_dataspace &config,
-		                      Xml_file &file)
+		                      Commit_pipeline &pipeline)
 		:
 			Root_component<Report_session_component>(env.ep(), md_alloc),
-			_env(env), _config(config), _xml_file(file)
+			_env(env), _config(config), _pipeline(pipeline)
 		{ }
 };
 
@@ -575,9 +1105,12 @@ struct Xml_editor::Main
 
 	Xml_file xml_file { heap, open_output_handle(), xml_file_path };
 
+	Commit_pipeline pipeline {
+		env, xml_file, config.xml().attribute_value("commit_window_ms", 0U) };
+
 	Sliced_heap report_heap { env.ram(), env.rm() };
 
-	Report_root_component report_root { env, report_heap, config, xml_file };
+	Report_root_component report_root { env, report_heap, config, pipeline };
 
 	Main(Genode::Env &env) : env(env)
 	{
@@ -0,0 +1,210 @@
+/*
+ * \brief  Filtering and calibration of analog axes
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _AXIS_FILTER_H_
+#define _AXIS_FILTER_H_
+
+/* Genode includes */
+#include <base/fixed_stdint.h>
+#include <util/string.h>
+#include <util/xml_node.h>
+#include <util/xml_generator.h>
+
+
+/**
+ * Filter of one coordinate of an analog axis
+ *
+ * A raw value is mapped from its calibrated range to [-RANGE, RANGE],
+ * values within the deadzone around the center are suppressed, and the
+ * response curve is applied. A new value is only worth an event if it
+ * differs from the last submitted one by at least the threshold, which
+ * keeps a noisy stick from flooding the Input session.
+ *
+ * An unconfigured filter passes the raw values unmodified.
+ */
+struct Axis_filter
+{
+	enum { RANGE = 32767, CENTER_TOLERANCE = 64 };
+
+	enum Curve { LINEAR, QUADRATIC, CUBIC };
+
+	struct Calibration
+	{
+		int min    = -RANGE;
+		int center = 0;
+		int max    = RANGE;
+	};
+
+	bool  active    = false;
+	bool  learn     = false;
+	int   deadzone  = 0;
+	int   threshold = 0;
+	Curve curve     = LINEAR;
+
+	Calibration cal      { };
+	Calibration reported { };
+
+	int  last      = 0;
+	bool submitted = false;
+
+	static int _abs(int v) { return v < 0 ? -v : v; }
+
+	static Curve _curve(Genode::Xml_node node, Curve curve)
+	{
+		typedef Genode::String<16> Name;
+		Name const name = node.attribute_value("curve", Name());
+
+		if (name == "linear")    return LINEAR;
+		if (name == "quadratic") return QUADRATIC;
+		if (name == "cubic")     return CUBIC;
+
+		return curve;
+	}
+
+	/**
+	 * Apply the attributes of an '<axis>' node
+	 *
+	 * \param coord  coordinate prefix of the calibration attributes,
+	 *               i.e., "x" or "y"
+	 */
+	void configure(Genode::Xml_node node, char const *coord)
+	{
+		typedef Genode::String<16> Attr;
+		Attr const min_attr   (coord, "_min");
+		Attr const center_attr(coord, "_center");
+		Attr const max_attr   (coord, "_max");
+
+		active    = true;
+		learn     = node.attribute_value("learn", learn);
+		deadzone  = Genode::min((int)RANGE - 1,
+		                        node.attribute_value("deadzone", deadzone));
+		threshold = node.attribute_value("threshold", threshold);
+		curve     = _curve(node, curve);
+
+		cal.center = node.attribute_value(center_attr.string(), cal.center);
+
+		/*
+		 * Learning starts from half the nominal range unless a previous
+		 * calibration is supplied, so the stick reaches full deflection
+		 * before it was moved to its physical limits once.
+		 */
+		bool const known = node.has_attribute(min_attr.string())
+		                || node.has_attribute(max_attr.string());
+		if (learn && !known) {
+			cal.min = cal.center - RANGE/2;
+			cal.max = cal.center + RANGE/2;
+		}
+
+		cal.min = node.attribute_value(min_attr.string(), cal.min);
+		cal.max = node.attribute_value(max_attr.string(), cal.max);
+
+		reported = cal;
+	}
+
+	/**
+	 * Return raw value scaled to [-RANGE, RANGE] by the calibration
+	 */
+	int _normalized(int raw) const
+	{
+		typedef Genode::int64_t int64_t;
+
+		int64_t const d    = (int64_t)raw - cal.center;
+		int64_t const span = d >= 0 ? (int64_t)cal.max - cal.center
+		                            : (int64_t)cal.center - cal.min;
+
+		int64_t v = span > 0 ? d*RANGE/span : 0;
+		if (v >  RANGE) v =  RANGE;
+		if (v < -RANGE) v = -RANGE;
+
+		return (int)v;
+	}
+
+	void _learn(int raw)
+	{
+		if (raw < cal.min) cal.min = raw;
+		if (raw > cal.max) cal.max = raw;
+
+		/* follow the drift of the resting position within the deadzone */
+		if (deadzone && _abs(_normalized(raw)) <= deadzone)
+			cal.center += (raw - cal.center) / 16;
+	}
+
+	/**
+	 * Return filtered value of a raw axis value
+	 */
+	int apply(int raw)
+	{
+		if (!active)
+			return raw;
+
+		if (learn)
+			_learn(raw);
+
+		typedef Genode::int64_t int64_t;
+
+		int64_t const v = _normalized(raw);
+
+		int64_t a = v < 0 ? -v : v;
+		if (a <= deadzone)
+			return 0;
+
+		a = (a - deadzone)*RANGE/(RANGE - deadzone);
+
+		switch (curve) {
+		case QUADRATIC: a = a*a/RANGE;           break;
+		case CUBIC:     a = a*a/RANGE*a/RANGE;   break;
+		case LINEAR:                             break;
+		}
+
+		return (int)(v < 0 ? -a : a);
+	}
+
+	/**
+	 * Return true if the filtered value warrants an event
+	 *
+	 * Returning to the center or reaching an end of the range is always
+	 * reported so that consumers never miss the resting position.
+	 */
+	bool significant(int v) const
+	{
+		if (!submitted)                      return true;
+		if (v == last)                       return false;
+		if (v == 0 || _abs(v) == RANGE)      return true;
+
+		return _abs(v - last) >= threshold;
+	}
+
+	void submit(int v)
+	{
+		last      = v;
+		submitted = true;
+	}
+
+	bool calibration_changed() const
+	{
+		return learn && (cal.min != reported.min || cal.max != reported.max
+		              || _abs(cal.center - reported.center) >= CENTER_TOLERANCE);
+	}
+
+	void report(Genode::Xml_generator &xml, char const *coord)
+	{
+		typedef Genode::String<16> Attr;
+		xml.attribute(Attr(coord, "_min").string(),    cal.min);
+		xml.attribute(Attr(coord, "_center").string(), cal.center);
+		xml.attribute(Attr(coord, "_max").string(),    cal.max);
+
+		reported = cal;
+	}
+};
+
+#endif /* _AXIS_FILTER_H_ */
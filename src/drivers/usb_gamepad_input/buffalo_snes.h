@@ -70,7 +70,7 @@ struct Buffalo_snes : Hid_device
 		return (o == 0x7f && n == 0x80) || (o == 0x80 && n == 0x7f);
 	}
 
-	Buffalo_snes(Input::Session_component &input_session)
+	Buffalo_snes(Device_input &input_session)
 	: Hid_device(input_session, "iBuffalo classic USB gamepad (SNES)")
 	{
 		/* initial values */
@@ -0,0 +1,129 @@
+/*
+ * \brief  Input session shared by several gamepads
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _DEVICE_INPUT_H_
+#define _DEVICE_INPUT_H_
+
+/* Genode includes */
+#include <base/log.h>
+#include <input/component.h>
+
+/* local includes */
+#include <axis_filter.h>
+
+
+/**
+ * Input of one gamepad, tagged with the ID of the gamepad
+ *
+ * Press and release events carry the device ID in 'ax'. Motion events
+ * of device N use the axis numbers starting at N * AXES_PER_DEVICE. The
+ * events of device 0 are therefore identical to those of a driver that
+ * serves a single gamepad.
+ *
+ * Motion events pass the axis filters of the device and are dropped if
+ * the filtered values do not differ significantly from the last ones.
+ */
+struct Device_input
+{
+	enum { AXES_PER_DEVICE = 8 };
+
+	Input::Session_component &session;
+
+	unsigned const id;
+
+	/* filters of the x and y coordinate of each axis */
+	Axis_filter filters[AXES_PER_DEVICE][2];
+
+	Device_input(Input::Session_component &session, unsigned id)
+	: session(session), id(id) { }
+
+	/**
+	 * Apply the '<axis>' sub nodes of a config node
+	 */
+	void configure(Genode::Xml_node node)
+	{
+		node.for_each_sub_node("axis", [&] (Genode::Xml_node axis) {
+			unsigned const n = axis.attribute_value("number", ~0U);
+			if (n >= AXES_PER_DEVICE) {
+				Genode::warning("ignoring invalid axis number ", n);
+				return;
+			}
+			filters[n][0].configure(axis, "x");
+			filters[n][1].configure(axis, "y");
+		});
+	}
+
+	bool calibration_changed() const
+	{
+		for (unsigned n = 0; n < AXES_PER_DEVICE; n++)
+			if (filters[n][0].calibration_changed()
+			 || filters[n][1].calibration_changed())
+				return true;
+
+		return false;
+	}
+
+	/**
+	 * Generate '<axis>' nodes of all learning axes
+	 */
+	void report_calibration(Genode::Xml_generator &xml)
+	{
+		for (unsigned n = 0; n < AXES_PER_DEVICE; n++) {
+			if (!filters[n][0].learn && !filters[n][1].learn)
+				continue;
+
+			xml.node("axis", [&] () {
+				xml.attribute("number", n);
+				filters[n][0].report(xml, "x");
+				filters[n][1].report(xml, "y");
+			});
+		}
+	}
+
+	void submit(Input::Event const &ev)
+	{
+		switch (ev.type()) {
+		case Input::Event::PRESS:
+		case Input::Event::RELEASE:
+			session.submit(Input::Event(ev.type(), ev.code(), id, 0, 0, 0));
+			return;
+		case Input::Event::MOTION:
+		{
+			unsigned const n = ev.code();
+			if (n >= AXES_PER_DEVICE)
+				return;
+
+			Axis_filter &fx = filters[n][0];
+			Axis_filter &fy = filters[n][1];
+
+			int const x = fx.apply(ev.ax());
+			int const y = fy.apply(ev.ay());
+
+			if (!fx.significant(x) && !fy.significant(y))
+				return;
+
+			fx.submit(x);
+			fy.submit(y);
+
+			session.submit(Input::Event(ev.type(), n + id*AXES_PER_DEVICE,
+			                            x, y, ev.rx(), ev.ry()));
+			return;
+		}
+		default:
+			session.submit(ev);
+			return;
+		}
+	}
+};
+
+#endif /* _DEVICE_INPUT_H_ */
@@ -60,7 +60,7 @@ struct Gravis_gamepadpro : Hid_device
 
 	uint8_t old_data[DATA_LENGTH] = { };
 
-	Gravis_gamepadpro(Input::Session_component &input_session)
+	Gravis_gamepadpro(Device_input &input_session)
 	: Hid_device(input_session, "Gravis Gamepad Pro") { }
 
 	/**************************
@@ -18,6 +18,10 @@
 #include <base/fixed_stdint.h>
 #include <util/string.h>
 
+/* local includes */
+#include <hid_report.h>
+#include <utils.h>
+
 
 struct Hid_device
 {
@@ -32,16 +36,184 @@ struct Hid_device
 	typedef Genode::String<64> Name;
 	Name name { "<generic USB HID gamepad>" };
 
-	Input::Session_component &input_session;
+	Device_input &input_session;
 
-	Hid_device(Input::Session_component &input_session, Name const &name)
+	Hid_device(Device_input &input_session, Name const &name)
 	: name(name), input_session(input_session) { }
 
-	Hid_device(Input::Session_component &input_session)
+	Hid_device(Device_input &input_session)
 	: input_session(input_session) { }
 
 	virtual ~Hid_device() { }
 
+	/*
+	 * Generic decoding driven by the HID report descriptor
+	 */
+
+	enum { AXES = 6, CENTER = 8 };
+
+	Hid_report const *report = nullptr;
+
+	Genode::int32_t values[Hid_report::MAX_FIELDS] { };
+	int16_t         axes[AXES][2] { };
+
+	/**
+	 * Use report layout for decoding reports
+	 */
+	void use_report(Hid_report const &r)
+	{
+		report = &r;
+
+		/* start with released buttons and centered hats */
+		for (unsigned i = 0; i < r.field_count; i++) {
+			Hid_report::Field const &f = r.fields[i];
+			values[i] = (f.usage_page == Hid_report::PAGE_GENERIC_DESKTOP
+			          && f.usage == Hid_report::USAGE_HAT)
+			          ? f.logical_max + 1 : 0;
+		}
+	}
+
+	static Input::Keycode button_keycode(unsigned usage)
+	{
+		static Input::Keycode const mapping[] = {
+			Input::Keycode::BTN_A,      Input::Keycode::BTN_B,
+			Input::Keycode::BTN_C,      Input::Keycode::BTN_X,
+			Input::Keycode::BTN_Y,      Input::Keycode::BTN_Z,
+			Input::Keycode::BTN_TL,     Input::Keycode::BTN_TR,
+			Input::Keycode::BTN_TL2,    Input::Keycode::BTN_TR2,
+			Input::Keycode::BTN_SELECT, Input::Keycode::BTN_START,
+			Input::Keycode::BTN_MODE,   Input::Keycode::BTN_THUMBL,
+			Input::Keycode::BTN_THUMBR,
+		};
+
+		/* button usages start at 1 */
+		if (usage == 0 || usage > sizeof(mapping)/sizeof(mapping[0]))
+			return Input::Keycode::KEY_UNKNOWN;
+		return mapping[usage - 1];
+	}
+
+	/**
+	 * Return axis and component of a generic-desktop usage or -1
+	 */
+	static int axis_index(unsigned usage, unsigned &component)
+	{
+		component = 0;
+		switch (usage) {
+		case Hid_report::USAGE_X:      return 0;
+		case Hid_report::USAGE_Y:      component = 1; return 0;
+		case Hid_report::USAGE_Z:      return 1;
+		case Hid_report::USAGE_RZ:     component = 1; return 1;
+		case Hid_report::USAGE_RX:     return 2;
+		case Hid_report::USAGE_RY:     return 3;
+		case Hid_report::USAGE_SLIDER: return 4;
+		case Hid_report::USAGE_DIAL:   return 5;
+		default:                       return -1;
+		}
+	}
+
+	static int16_t normalize_axis(Hid_report::Field const &f, Genode::int32_t v)
+	{
+		Genode::int64_t const range = (Genode::int64_t)f.logical_max - f.logical_min;
+		if (range <= 0)
+			return 0;
+
+		Genode::int64_t n = ((Genode::int64_t)v - f.logical_min) * 0xffff / range - 0x8000;
+		if (n < -0x7fff) n = -0x7fff;
+		if (n >  0x7fff) n =  0x7fff;
+		return (int16_t)n;
+	}
+
+	/**
+	 * Map hat value to the direction index used by 'Utils::check_hat'
+	 */
+	static uint8_t normalize_hat(Hid_report::Field const &f, Genode::int32_t v)
+	{
+		Genode::int32_t h = v - f.logical_min;
+		if (h < 0 || v > f.logical_max)
+			return CENTER;
+
+		/* four-way hats report in steps of 90 degrees */
+		if (f.logical_max - f.logical_min == 3)
+			h *= 2;
+
+		return h < CENTER ? h : CENTER;
+	}
+
+	void submit_button(unsigned usage, bool press)
+	{
+		Input::Keycode const key = button_keycode(usage);
+		if (key == Input::Keycode::KEY_UNKNOWN)
+			return;
+
+		Input::Event ev(press ? Input::Event::PRESS : Input::Event::RELEASE,
+		                key, 0, 0, 0, 0);
+		input_session.submit(ev);
+	}
+
+	/**
+	 * Decode report by extracting each field of the report layout
+	 */
+	void decode(uint8_t const *new_data, size_t len)
+	{
+		using Field = Hid_report::Field;
+
+		if (!len)
+			return;
+
+		uint8_t const id = report->report_ids ? new_data[0] : 0;
+
+		int16_t old_axes[AXES][2];
+		Genode::memcpy(old_axes, axes, sizeof(axes));
+		bool axis_changed[AXES] { };
+
+		for (unsigned i = 0; i < report->field_count; i++) {
+			Field const &f = report->fields[i];
+
+			if (f.report_id != id || !f.fits(len))
+				continue;
+
+			Genode::int32_t const v = f.extract(new_data);
+			Genode::int32_t const o = values[i];
+			if (v == o)
+				continue;
+			values[i] = v;
+
+			if (f.usage_page == Hid_report::PAGE_BUTTON) {
+				if (f.variable()) {
+					submit_button(f.usage, v != 0);
+				} else {
+					/* array of button indices, zero is no button */
+					if (o) submit_button(report->array_usage(f, o), false);
+					if (v) submit_button(report->array_usage(f, v), true);
+				}
+				continue;
+			}
+
+			if (f.usage_page != Hid_report::PAGE_GENERIC_DESKTOP)
+				continue;
+
+			if (f.usage == Hid_report::USAGE_HAT) {
+				Utils::check_hat(input_session, normalize_hat(f, o),
+				                                normalize_hat(f, v));
+				continue;
+			}
+
+			unsigned component = 0;
+			int const axis = axis_index(f.usage, component);
+			if (axis < 0)
+				continue;
+
+			axes[axis][component] = normalize_axis(f, v);
+			axis_changed[axis]    = true;
+		}
+
+		for (unsigned a = 0; a < AXES; a++)
+			if (axis_changed[a])
+				Utils::check_axis(input_session,
+				                  old_axes[a][0], axes[a][0],
+				                  old_axes[a][1], axes[a][1], a);
+	}
+
 	/**************************
 	 ** HID device interface **
 	 **************************/
@@ -56,6 +228,11 @@ struct Hid_device
 	{
 		using namespace Genode;
 
+		if (report && report->field_count) {
+			decode(new_data, len);
+			return;
+		}
+
 		if (MAX_DATA < len) {
 			warning("limit data len: ", len, " to: ", (int)MAX_DATA);
 			len = MAX_DATA;
@@ -87,6 +264,51 @@ struct Hid_device
 		Genode::warning(__func__, "(): not implemented, returning 0");
 		return 0;
 	}
+
+	/*
+	 * Output features
+	 */
+
+	struct Output
+	{
+		uint8_t strong = 0;  /* low-frequency rumble motor */
+		uint8_t weak   = 0;  /* high-frequency rumble motor */
+		uint8_t leds   = 0;  /* bitmap of the player LEDs */
+		uint8_t red    = 0;  /* color of the lightbar */
+		uint8_t green  = 0;
+		uint8_t blue   = 0;
+
+		bool operator != (Output const &o) const
+		{
+			return strong != o.strong || weak  != o.weak  || leds != o.leds
+			    || red    != o.red    || green != o.green || blue != o.blue;
+		}
+	};
+
+	enum Output_transfer {
+		OUTPUT_NONE,       /* device has no output features */
+		OUTPUT_IRQ,        /* reports go to the interrupt OUT endpoint */
+		OUTPUT_SET_REPORT, /* reports are sent by a SET_REPORT request */
+	};
+
+	virtual Output_transfer output_transfer() const { return OUTPUT_NONE; }
+
+	/**
+	 * Generate output report
+	 *
+	 * \param i    index of the report, devices may need several reports
+	 *             to apply all output features
+	 * \param buf  buffer receiving the report, which starts with the
+	 *             report ID for 'OUTPUT_SET_REPORT'
+	 * \return     length of the report, 0 if there is no report 'i'
+	 */
+	virtual size_t output_report(Output const &, unsigned i,
+	                             uint8_t *buf, size_t max) { return 0; }
+
+	/**
+	 * Called once output report 'i' was submitted to the device
+	 */
+	virtual void output_submitted(unsigned i) { }
 };
 
 #endif /* _HID_DEVICE_H_ */
@@ -0,0 +1,315 @@
+/*
+ * \brief  USB HID report descriptor parser
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _HID_REPORT_H_
+#define _HID_REPORT_H_
+
+/* Genode includes */
+#include <base/exception.h>
+#include <base/fixed_stdint.h>
+#include <util/string.h>
+
+
+/**
+ * Input report layout compiled from a HID report descriptor
+ *
+ * Every data item of an input report becomes one field that records its
+ * position within the report, its usage, and its logical range. Decoding
+ * a report is thereby reduced to a bit extraction per field.
+ */
+struct Hid_report
+{
+	typedef Genode::uint8_t  uint8_t;
+	typedef Genode::uint16_t uint16_t;
+	typedef Genode::uint32_t uint32_t;
+	typedef Genode::int32_t  int32_t;
+	typedef Genode::uint64_t uint64_t;
+	typedef Genode::size_t   size_t;
+
+	struct Invalid_report : Genode::Exception { };
+
+	enum { MAX_FIELDS = 64, MAX_USAGES = 16, MAX_STACK = 4,
+	       MAX_ARRAY_USAGES = 64, };
+
+	enum Flags { CONSTANT = 0x1, VARIABLE = 0x2, RELATIVE = 0x4, };
+
+	enum Usage_page {
+		PAGE_GENERIC_DESKTOP = 0x01,
+		PAGE_BUTTON          = 0x09,
+	};
+
+	enum Generic_desktop_usage {
+		USAGE_X      = 0x30,
+		USAGE_Y      = 0x31,
+		USAGE_Z      = 0x32,
+		USAGE_RX     = 0x33,
+		USAGE_RY     = 0x34,
+		USAGE_RZ     = 0x35,
+		USAGE_SLIDER = 0x36,
+		USAGE_DIAL   = 0x37,
+		USAGE_WHEEL  = 0x38,
+		USAGE_HAT    = 0x39,
+	};
+
+	struct Field
+	{
+		uint16_t bit_offset;
+		uint8_t  bit_size;
+		uint8_t  report_id;
+		uint16_t usage_page;
+		uint16_t usage;      /* for arrays the first usage of the range */
+		uint8_t  flags;
+		int32_t  logical_min;
+		int32_t  logical_max;
+
+		/* discrete usages of an array in 'array_usages', none for a range */
+		uint8_t  array_index;
+		uint8_t  array_count;
+
+		bool variable() const { return flags & VARIABLE; }
+
+		/**
+		 * Return true if the field lies within a report of 'len' bytes
+		 */
+		bool fits(size_t len) const {
+			return (size_t)(bit_offset + bit_size + 7) / 8 <= len; }
+
+		/**
+		 * Extract the field value from a report, sign-extended if the
+		 * logical range is signed
+		 */
+		int32_t extract(uint8_t const *data) const
+		{
+			unsigned const byte  = bit_offset / 8;
+			unsigned const shift = bit_offset % 8;
+			unsigned const bytes = (shift + bit_size + 7) / 8;
+
+			uint64_t raw = 0;
+			for (unsigned i = 0; i < bytes; i++)
+				raw |= (uint64_t)data[byte + i] << (8*i);
+
+			uint64_t const mask = (1ULL << bit_size) - 1;
+			uint32_t v = (uint32_t)((raw >> shift) & mask);
+
+			if (logical_min < 0 && bit_size < 32 && (v & (1U << (bit_size - 1))))
+				v |= ~(uint32_t)mask;
+
+			return (int32_t)v;
+		}
+	};
+
+	Field    fields[MAX_FIELDS];
+	unsigned field_count = 0;
+
+	uint16_t array_usages[MAX_ARRAY_USAGES];
+	unsigned array_usage_count = 0;
+
+	/* reports are prefixed by a report ID byte */
+	bool report_ids = false;
+
+	/**
+	 * Return usage selected by value 'v' of array field 'f'
+	 *
+	 * eturn usage or 0 if the value selects no usage
+	 */
+	unsigned array_usage(Field const &f, int32_t v) const
+	{
+		Genode::int64_t const i = (Genode::int64_t)v - f.logical_min;
+		if (i < 0)
+			return 0;
+
+		if (!f.array_count)
+			return (unsigned)(f.usage + i);
+
+		return i < f.array_count ? array_usages[f.array_index + i] : 0;
+	}
+
+	/**
+	 * Compile report descriptor
+	 *
+	 * \throw Invalid_report
+	 */
+	static Hid_report parse(uint8_t const *desc, size_t len)
+	{
+		enum { MAIN = 0, GLOBAL = 1, LOCAL = 2, LONG_ITEM = 0xfe };
+
+		enum {
+			MAIN_INPUT = 0x8, MAIN_OUTPUT = 0x9, MAIN_COLLECTION = 0xa,
+			MAIN_FEATURE = 0xb, MAIN_END_COLLECTION = 0xc,
+
+			GLOBAL_USAGE_PAGE = 0x0, GLOBAL_LOGICAL_MIN = 0x1,
+			GLOBAL_LOGICAL_MAX = 0x2, GLOBAL_REPORT_SIZE = 0x7,
+			GLOBAL_REPORT_ID = 0x8, GLOBAL_REPORT_COUNT = 0x9,
+			GLOBAL_PUSH = 0xa, GLOBAL_POP = 0xb,
+
+			LOCAL_USAGE = 0x0, LOCAL_USAGE_MIN = 0x1, LOCAL_USAGE_MAX = 0x2,
+		};
+
+		struct Globals
+		{
+			uint16_t usage_page   = 0;
+			int32_t  logical_min  = 0;
+			uint32_t logical_max  = 0;
+			int32_t  logical_max_signed = 0;
+			uint32_t report_size  = 0;
+			uint32_t report_count = 0;
+			uint8_t  report_id    = 0;
+		} global, stack[MAX_STACK];
+
+		unsigned sp = 0;
+
+		struct Locals
+		{
+			uint16_t usages[MAX_USAGES];
+			unsigned usage_count = 0;
+			uint32_t usage_min   = 0;
+			uint32_t usage_max   = 0;
+			bool     range       = false;
+		} local;
+
+		/* next bit offset of each report */
+		uint32_t offsets[256] { };
+
+		Hid_report report;
+
+		size_t i = 0;
+		while (i < len) {
+			uint8_t const prefix = desc[i++];
+
+			if (prefix == LONG_ITEM) {
+				if (i + 1 >= len) throw Invalid_report();
+				i += 2 + desc[i];
+				continue;
+			}
+
+			unsigned const size = (prefix & 3) == 3 ? 4 : (prefix & 3);
+			unsigned const type = (prefix >> 2) & 3;
+			unsigned const tag  = prefix >> 4;
+
+			if (i + size > len) throw Invalid_report();
+
+			uint32_t u = 0;
+			for (unsigned k = 0; k < size; k++)
+				u |= (uint32_t)desc[i + k] << (8*k);
+			i += size;
+
+			int32_t s = (int32_t)u;
+			if (size == 1) s = (Genode::int8_t)u;
+			if (size == 2) s = (Genode::int16_t)u;
+
+			switch (type) {
+			case MAIN:
+				if (tag == MAIN_INPUT) {
+					uint8_t  const id  = global.report_id;
+					uint32_t &offset   = offsets[id];
+					if (report.report_ids && offset == 0)
+						offset = 8;
+
+					uint32_t const bits = global.report_size;
+
+					if ((u & CONSTANT) || bits == 0 || bits > 32) {
+						offset += bits*global.report_count;
+					} else {
+						int32_t const lmin = global.logical_min;
+						int32_t const lmax = lmin < 0 ? global.logical_max_signed
+						                              : (int32_t)global.logical_max;
+
+						/*
+						 * An array without usage range selects one of the
+						 * discrete usages by its value
+						 */
+						uint8_t array_index = 0, array_count = 0;
+						if (!(u & VARIABLE) && !local.range && local.usage_count
+						 && report.array_usage_count + local.usage_count <= MAX_ARRAY_USAGES) {
+							array_index = (uint8_t)report.array_usage_count;
+							array_count = (uint8_t)local.usage_count;
+							for (unsigned k = 0; k < local.usage_count; k++)
+								report.array_usages[report.array_usage_count++] = local.usages[k];
+						}
+
+						for (uint32_t n = 0; n < global.report_count; n++) {
+
+							uint32_t usage = 0;
+							if (local.range)
+								usage = (u & VARIABLE)
+								      ? Genode::min(local.usage_min + n, local.usage_max)
+								      : local.usage_min;
+							else if (local.usage_count)
+								usage = (u & VARIABLE)
+								      ? local.usages[Genode::min(n, local.usage_count - 1)]
+								      : local.usages[0];
+
+							if (report.field_count < MAX_FIELDS && offset + bits <= 0xffff)
+								report.fields[report.field_count++] = Field {
+									(uint16_t)offset, (uint8_t)bits, id,
+									global.usage_page, (uint16_t)usage,
+									(uint8_t)(u & (VARIABLE | RELATIVE)),
+									lmin, lmax, array_index, array_count };
+
+							offset += bits;
+						}
+					}
+				}
+
+				/* output and feature reports are not decoded */
+				local = Locals();
+				break;
+
+			case GLOBAL:
+				switch (tag) {
+				case GLOBAL_USAGE_PAGE:   global.usage_page   = u; break;
+				case GLOBAL_LOGICAL_MIN:  global.logical_min  = s; break;
+				case GLOBAL_LOGICAL_MAX:
+					global.logical_max        = u;
+					global.logical_max_signed = s;
+					break;
+				case GLOBAL_REPORT_SIZE:  global.report_size  = u; break;
+				case GLOBAL_REPORT_COUNT: global.report_count = u; break;
+				case GLOBAL_REPORT_ID:
+					if (u == 0 || u > 0xff) throw Invalid_report();
+					global.report_id  = u;
+					report.report_ids = true;
+					break;
+				case GLOBAL_PUSH:
+					if (sp == MAX_STACK) throw Invalid_report();
+					stack[sp++] = global;
+					break;
+				case GLOBAL_POP:
+					if (sp == 0) throw Invalid_report();
+					global = stack[--sp];
+					break;
+				default: break;
+				}
+				break;
+
+			case LOCAL:
+				switch (tag) {
+				case LOCAL_USAGE:
+					if (local.usage_count < MAX_USAGES)
+						local.usages[local.usage_count++] = u & 0xffff;
+					break;
+				case LOCAL_USAGE_MIN: local.usage_min = u & 0xffff; local.range = true; break;
+				case LOCAL_USAGE_MAX: local.usage_max = u & 0xffff; local.range = true; break;
+				default: break;
+				}
+				break;
+
+			default: break;
+			}
+		}
+
+		return report;
+	}
+};
+
+#endif /* _HID_REPORT_H_ */
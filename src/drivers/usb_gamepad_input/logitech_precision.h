@@ -73,7 +73,7 @@ struct Logitech_precision : Hid_device
 
 	uint8_t last[DATA_LENGTH] = {};
 
-	Logitech_precision(Input::Session_component &input_session)
+	Logitech_precision(Device_input &input_session)
 	: Hid_device(input_session, "Logitech, Inc. Precision Gamepad")
 	{
 		/* initial values */
@@ -28,6 +28,8 @@
 
 /* local includes */
 #include <utils.h>
+#include <device_input.h>
+#include <hid_report.h>
 #include <hid_device.h>
 
 /* include known gamepads */
@@ -64,8 +66,11 @@ namespace Usb {
  */
 struct Usb::Hid
 {
-	Env                      &env;
-	Input::Session_component &input_session;
+	typedef String<64> Label;
+
+	Env          &env;
+	Label const   label;
+	Device_input  input_session;
 
 	/*
 	 * Supported USB HID gamepads
@@ -95,26 +100,35 @@ struct Usb::Hid
 
 	Hid_device *device = &generic;
 
-	Timer::Connection timer { env };
+	/*
+	 * IRQ transfers kept in flight
+	 *
+	 * Each completed transfer is resubmitted right away so that the host
+	 * controller always has a pending request when the device delivers
+	 * its next report at the polling interval of the endpoint.
+	 */
+	enum { IRQ_TRANSFERS = 4 };
 
-	unsigned polling_us = 0;
+	unsigned irq_in_flight = 0;
+	bool     irq_active    = false;
 
 	void state_change()
 	{
 		if (usb.plugged()) {
-			log("Gamepad plugged in");
+			log("Gamepad ", input_session.id, " (", label, ") plugged in");
 			probe_device();
 			return;
 		}
 
-		log("Gamepad unplugged");
+		irq_active = false;
+		log("Gamepad ", input_session.id, " (", label, ") unplugged");
 	}
 
 	/* construct before Usb::Connection so the dispatcher is valid */
 	Signal_handler<Hid> state_dispatcher { env.ep(), *this, &Hid::state_change };
 
 	Allocator_avl    usb_alloc;
-	Usb::Connection  usb { env, &usb_alloc, "usb_gamepad", 32*1024, state_dispatcher };
+	Usb::Connection  usb { env, &usb_alloc, label.string(), 32*1024, state_dispatcher };
 
 	Usb::Config_descriptor    config_descr;
 	Usb::Device_descriptor    device_descr;
@@ -125,12 +139,7 @@ struct Usb::Hid
 
 	void handle_config_packet(Packet_descriptor &p) { _claim_device(); }
 
-	struct Hid_report
-	{
-		struct Invalid_report : Genode::Exception { };
-	};
-
-	Hid_report hid_report;
+	Hid_report hid_report { };
 
 	Hid_report parse_hid_report(uint8_t const *r, size_t len)
 	{
@@ -145,7 +154,7 @@ struct Usb::Hid
 			}
 		}
 
-		return Hid_report();
+		return Hid_report::parse(r, len);
 	}
 
 	struct Hid_report_descriptor
@@ -188,16 +197,22 @@ struct Usb::Hid
 		size_t           const len = p.control.actual_size > 0
 		                           ? p.control.actual_size : 0;
 
-		try {
-			/* XXX only parse HID report if not already known */
-			hid_report = parse_hid_report(data, len);
-		} catch (Hid_report::Invalid_report) {
-			error("HID report is invalid");
-			return;
+		/* devices with a dedicated driver know their report layout */
+		if (device == &generic) {
+			try {
+				hid_report = parse_hid_report(data, len);
+				generic.use_report(hid_report);
+				log("HID report describes ", hid_report.field_count, " input fields");
+			} catch (Hid_report::Invalid_report) {
+				error("HID report is invalid");
+				return;
+			}
 		}
 
-		/* kick-off polling */
-		timer.trigger_once(polling_us);
+		/* kick-off IRQ transfers */
+		irq_active = true;
+		submit_irq_transfers();
+		submit_output();
 	}
 
 	void handle_irq_packet(Packet_descriptor &p)
@@ -213,11 +228,182 @@ struct Usb::Hid
 		}
 		catch (...) {
 			error("input data is invalid, reconnect device");
+			irq_active = false;
 			return;
 		}
+	}
+
+	void submit_irq_transfers()
+	{
+		while (irq_active && irq_in_flight < IRQ_TRANSFERS) {
+			Usb::Packet_descriptor p;
+			try { p = alloc_packet(ep_descr.max_packet_size); }
+			catch (Queue_full)         { return; }
+			catch (No_completion_free) { return; }
+
+			p.type                      = Usb::Packet_descriptor::IRQ;
+			p.succeded                  = false;
+			p.transfer.ep               = ep_descr.address;
+			p.transfer.polling_interval = ep_descr.polling_interval;
+
+			usb.source()->submit_packet(p);
+			irq_in_flight++;
+		}
+	}
+
+	/*
+	 * Output channel for rumble, LEDs, and the lightbar
+	 *
+	 * Output reports are sent one at a time and at most once per output
+	 * interval. A report is only allocated while more completions are
+	 * free than IRQ transfers are kept in flight, so output never takes
+	 * the place of an input transfer. Requests that arrive in between
+	 * are merged into the latest state.
+	 */
+	enum { MAX_OUTPUT_REPORT = 64 };
+
+	Hid_device::Output output_requested { };
+	Hid_device::Output output_current   { };
+	Hid_device::Output output_sent      { };
+
+	unsigned output_index     = 0;
+	bool     output_in_flight = false;
+	uint64_t output_last_us   = 0;
+	uint64_t output_interval_us = 0;
+
+	Usb::Endpoint_descriptor ep_out_descr { };
+	bool                     ep_out_valid = false;
+
+	Timer::Connection *output_timer = nullptr;
+
+	void handle_output_timeout(Duration) { submit_output(); }
+
+	Constructible<Timer::One_shot_timeout<Hid>> output_timeout { };
+
+	void enable_output(Timer::Connection &timer, unsigned interval_ms)
+	{
+		output_timer       = &timer;
+		output_interval_us = 1000ULL*interval_ms;
+		output_timeout.construct(timer, *this, &Hid::handle_output_timeout);
+	}
+
+	void request_output(Hid_device::Output const &o)
+	{
+		output_requested = o;
+		submit_output();
+	}
+
+	/**
+	 * Try again after the output interval if no packet was available
+	 */
+	void retry_output()
+	{
+		enum { MIN_RETRY_US = 1000 };
+		output_timeout->schedule(Microseconds {
+			output_interval_us > MIN_RETRY_US ? output_interval_us : MIN_RETRY_US });
+	}
 
-		/* keep on r^Wpolling */
-		if (polling_us) { timer.trigger_once(polling_us); }
+	unsigned free_completions() const
+	{
+		unsigned n = 0;
+		for (unsigned i = 0; i < Usb::Session::TX_QUEUE_SIZE; i++)
+			if (completions[i].state == Completion::FREE)
+				n++;
+		return n;
+	}
+
+	void submit_output()
+	{
+		Hid_device::Output_transfer const transfer = device->output_transfer();
+
+		if (!output_timer || output_in_flight || !irq_active)
+			return;
+
+		if (transfer == Hid_device::OUTPUT_NONE
+		 || (transfer == Hid_device::OUTPUT_IRQ && !ep_out_valid))
+			return;
+
+		if (!output_index && !(output_requested != output_sent))
+			return;
+
+		uint64_t const now = output_timer->curr_time().trunc_to_plain_us().value;
+		if (output_last_us && now < output_last_us + output_interval_us) {
+			output_timeout->schedule(Microseconds { output_last_us + output_interval_us - now });
+			return;
+		}
+
+		if (free_completions() <= IRQ_TRANSFERS)
+			return;
+
+		/*
+		 * Continue with the next report or start over with the latest
+		 * state, the output state is updated only once the report is
+		 * submitted
+		 */
+		Hid_device::Output next  = output_current;
+		unsigned           index = output_index;
+
+		uint8_t buf[MAX_OUTPUT_REPORT];
+		size_t len = index
+		           ? device->output_report(next, index, buf, sizeof(buf))
+		           : 0;
+		if (!len) {
+			if (index) {
+				output_sent  = output_current;
+				output_index = 0;
+			}
+			if (!(output_requested != output_sent))
+				return;
+
+			next  = output_requested;
+			index = 0;
+			len   = device->output_report(next, index, buf, sizeof(buf));
+			if (!len)
+				return;
+		}
+
+		Usb::Packet_descriptor p;
+		try { p = alloc_packet(len); }
+		catch (Queue_full)         { retry_output(); return; }
+		catch (No_completion_free) { retry_output(); return; }
+		catch (Usb::Session::Tx::Source::Packet_alloc_failed) {
+			retry_output(); return; }
+
+		Genode::memcpy(usb.source()->packet_content(p), buf, len);
+
+		if (transfer == Hid_device::OUTPUT_IRQ) {
+			p.type                      = Usb::Packet_descriptor::IRQ;
+			p.transfer.ep               = ep_out_descr.address;
+			p.transfer.polling_interval = ep_out_descr.polling_interval;
+		} else {
+			enum {
+				USB_REQUEST_TO_DEVICE      = 0x00,
+				USB_REQUEST_TYPE_CLASS     = 0x20,
+				USB_REQUEST_RCPT_IFACE     = 0x01,
+				USB_HID_REQUEST_SET_REPORT = 0x09,
+				USB_HID_OUTPUT_REPORT      = 0x02,
+
+				REQUEST = USB_REQUEST_TO_DEVICE | USB_REQUEST_TYPE_CLASS | USB_REQUEST_RCPT_IFACE,
+			};
+
+			p.type                 = Usb::Packet_descriptor::CTRL;
+			p.control.request      = USB_HID_REQUEST_SET_REPORT;
+			p.control.request_type = REQUEST;
+			p.control.value        = (USB_HID_OUTPUT_REPORT << 8) | buf[0];
+			p.control.index        = device->iface();
+			p.control.timeout      = 1000;
+		}
+
+		static_cast<Completion *>(p.completion)->output = true;
+
+		usb.source()->submit_packet(p);
+
+		output_current   = next;
+		output_index     = index + 1;
+		output_in_flight = true;
+		output_last_us   = now;
+
+		device->output_submitted(index);
 	}
 
 	struct String_descr
@@ -281,11 +467,14 @@ struct Usb::Hid
 		enum State { VALID, FREE, CANCELED };
 		State state = FREE;
 
+		/* output reports need no processing on completion */
+		bool output = false;
+
 		void complete(Usb::Packet_descriptor &p) override { }
 
 		void complete(Usb::Hid &hid, Usb::Packet_descriptor &p)
 		{
-			if (state != VALID)
+			if (state != VALID || output)
 				return;
 
 			if (!p.succeded) {
@@ -317,9 +506,35 @@ struct Usb::Hid
 	{
 		while (usb.source()->ack_avail()) {
 			Usb::Packet_descriptor p = usb.source()->get_acked_packet();
+
+			bool const irq_in = p.type == Usb::Packet_descriptor::IRQ
+			                 && p.read_transfer();
+
+			/* a failed transfer, e.g., due to unplugging, ends the stream */
+			if (irq_in && !p.succeded)
+				irq_active = false;
+
+			bool const output = dynamic_cast<Completion *>(p.completion)->output;
+
+			/* give up on a state the device refuses */
+			if (output && !p.succeded) {
+				output_sent  = output_current;
+				output_index = 0;
+			}
+
 			dynamic_cast<Completion *>(p.completion)->complete(*this, p);
 			free_packet(p);
+
+			if (irq_in) {
+				irq_in_flight--;
+				submit_irq_transfers();
+			}
+
+			if (output)
+				output_in_flight = false;
 		}
+
+		submit_output();
 	}
 
 	Signal_handler<Hid> ack_avail_dispatcher { env.ep(), *this, &Hid::ack_avail };
@@ -391,9 +606,20 @@ struct Usb::Hid
 			return false;
 		}
 
-		polling_us = 1000 * ep_descr.polling_interval;
-
-		if (debug) { polling_us = 1000 * 1000; }
+		/* look for an interrupt OUT endpoint used for output reports */
+		enum { ENDPOINT_IN = 0x80, ENDPOINT_TYPE_MASK = 0x3, ENDPOINT_INTERRUPT = 0x3 };
+		ep_out_valid = false;
+		for (unsigned i = 0; i < iface_descr.num_endpoints && !ep_out_valid; i++) {
+			Usb::Endpoint_descriptor d;
+			try { usb.endpoint_descriptor(iface, alt, i, &d); }
+			catch (Usb::Session::Interface_not_found) { break; }
+
+			if (!(d.address & ENDPOINT_IN)
+			 && (d.attributes & ENDPOINT_TYPE_MASK) == ENDPOINT_INTERRUPT) {
+				ep_out_descr = d;
+				ep_out_valid = true;
+			}
+		}
 
 		/*
 		 * Request HID report descriptor here because certain devices,
@@ -408,8 +634,10 @@ struct Usb::Hid
 		if (device == &xboxone) {
 			log("Enable XBox One quirk");
 
-			Usb::Endpoint_descriptor ep_out_descr;
-			usb.endpoint_descriptor(0, 0, 0, &ep_out_descr);
+			if (!ep_out_valid) {
+				usb.endpoint_descriptor(0, 0, 0, &ep_out_descr);
+				ep_out_valid = true;
+			}
 
 			Usb::Packet_descriptor p = alloc_packet(5);
 
@@ -470,21 +698,6 @@ struct Usb::Hid
 		return true;
 	}
 
-	void handle_polling()
-	{
-		Usb::Packet_descriptor p = alloc_packet(ep_descr.max_packet_size);
-
-		p.type                      = Usb::Packet_descriptor::IRQ;
-		p.succeded                  = false;
-		p.transfer.ep               = ep_descr.address;
-		p.transfer.polling_interval = 10;
-
-		usb.source()->submit_packet(p);
-	}
-
-	Signal_handler<Hid> polling_dispatcher = {
-		env.ep(), *this, &Hid::handle_polling };
-
 	Completion *_alloc_completion()
 	{
 		for (unsigned i = 0; i < Usb::Session::TX_QUEUE_SIZE; i++)
@@ -516,7 +729,9 @@ struct Usb::Hid
 
 	void free_packet(Usb::Packet_descriptor &packet)
 	{
-		dynamic_cast<Completion *>(packet.completion)->state = Completion::FREE;
+		Completion &c = *dynamic_cast<Completion *>(packet.completion);
+		c.state  = Completion::FREE;
+		c.output = false;
 		usb.source()->release_packet(packet);
 	}
 
@@ -525,15 +740,16 @@ struct Usb::Hid
 	 *
 	 * \param env    environment
 	 * \param alloc  allocator used by Usb::Connection
-	 * \param input  Input session
+	 * \param input  Input session shared by all gamepads
+	 * \param id     device ID used to tag the input events
+	 * \param label  label of the Usb session
 	 */
-	Hid(Env &env, Genode::Allocator &alloc, Input::Session_component &input)
-	: env(env), input_session(input), usb_alloc(&alloc)
+	Hid(Env &env, Genode::Allocator &alloc, Input::Session_component &input,
+	    unsigned id, Label const &label)
+	: env(env), label(label), input_session(input, id), usb_alloc(&alloc)
 	{
 		usb.tx_channel()->sigh_ack_avail(ack_avail_dispatcher);
 
-		timer.sigh(polling_dispatcher);
-
 		/* HID gets initialized by state_change() */
 	}
 };
@@ -547,11 +763,147 @@ struct Usb::Main
 	Input::Session_component    input_session { env, env.pd() };
 	Static_root<Input::Session> input_root { env.ep().manage(input_session) };
 
-	Usb::Hid hid { env, heap, input_session };
+	enum { MAX_PADS = 8 };
+
+	Usb::Hid *pads[MAX_PADS] { };
+	unsigned  pad_count = 0;
+
+	Usb::Hid *add_pad(Usb::Hid::Label const &label)
+	{
+		if (pad_count == MAX_PADS) {
+			warning("ignoring gamepad ", label, ", limit of ", (unsigned)MAX_PADS, " reached");
+			return nullptr;
+		}
+
+		pads[pad_count] = new (heap) Usb::Hid(env, heap, input_session,
+		                                      pad_count, label);
+		return pads[pad_count++];
+	}
+
+	/*
+	 * Calibration learned at runtime, checked for changes once a second
+	 */
+	Reporter calibration_reporter { env, "calibration" };
+
+	Constructible<Timer::Connection> timer { };
+
+	Constructible<Timer::Periodic_timeout<Main>> report_timeout { };
+
+	void report_calibration(Duration)
+	{
+		bool changed = false;
+		for (unsigned i = 0; i < pad_count; i++)
+			changed |= pads[i]->input_session.calibration_changed();
+
+		if (!changed)
+			return;
+
+		Reporter::Xml_generator xml(calibration_reporter, [&] () {
+			for (unsigned i = 0; i < pad_count; i++)
+				xml.node("device", [&] () {
+					xml.attribute("label", pads[i]->label);
+					pads[i]->input_session.report_calibration(xml);
+				});
+		});
+	}
+
+	/*
+	 * Output requests, each '<device>' node of the ROM applies to the
+	 * gamepad with the matching label or, without label, to all
+	 */
+	Constructible<Attached_rom_dataspace> output_rom { };
+
+	void handle_output()
+	{
+		output_rom->update();
+		Xml_node const output = output_rom->xml();
+
+		auto value = [] (Xml_node node, char const *attr, uint8_t v) {
+			return (uint8_t)min(255U, node.attribute_value(attr, (unsigned)v)); };
+
+		for (unsigned i = 0; i < pad_count; i++) {
+			Hid_device::Output o { };
+
+			output.for_each_sub_node("device", [&] (Xml_node node) {
+				if (node.has_attribute("label")
+				 && node.attribute_value("label", Usb::Hid::Label()) != pads[i]->label)
+					return;
+
+				o.strong = value(node, "strong", o.strong);
+				o.weak   = value(node, "weak",   o.weak);
+				o.leds   = value(node, "leds",   o.leds);
+				o.red    = value(node, "red",    o.red);
+				o.green  = value(node, "green",  o.green);
+				o.blue   = value(node, "blue",   o.blue);
+			});
+
+			pads[i]->request_output(o);
+		}
+	}
+
+	Signal_handler<Main> output_handler { env.ep(), *this, &Main::handle_output };
 
 	Main(Env &env) : env(env)
 	{
 		input_session.event_queue().enabled(true);
+
+		bool     report             = false;
+		bool     output             = false;
+		unsigned output_interval_ms = 20;
+
+		/*
+		 * Every '<device>' node results in a separate Usb session whose
+		 * label is used to route the session to a particular device.
+		 * Top-level '<axis>' nodes apply to all devices and are refined
+		 * by the '<axis>' nodes of a '<device>'.
+		 */
+		try {
+			Attached_rom_dataspace config { env, "config" };
+			Xml_node const root = config.xml();
+
+			root.for_each_sub_node("device", [&] (Xml_node node) {
+				Usb::Hid *pad = add_pad(node.attribute_value("label",
+				                        Usb::Hid::Label("usb_gamepad")));
+				if (!pad) return;
+
+				pad->input_session.configure(root);
+				pad->input_session.configure(node);
+			});
+
+			if (!pad_count)
+				add_pad("usb_gamepad")->input_session.configure(root);
+
+			if (root.has_sub_node("report"))
+				report = root.sub_node("report").attribute_value("calibration", false);
+
+			if (root.has_sub_node("output")) {
+				output = true;
+				output_interval_ms = root.sub_node("output")
+					.attribute_value("interval_ms", output_interval_ms);
+			}
+		} catch (...) { }
+
+		if (!pad_count)
+			add_pad("usb_gamepad");
+
+		if (report || output)
+			timer.construct(env);
+
+		if (report) {
+			calibration_reporter.enabled(true);
+			report_timeout.construct(*timer, *this, &Main::report_calibration,
+			                         Microseconds { 1000*1000 });
+		}
+
+		if (output) {
+			for (unsigned i = 0; i < pad_count; i++)
+				pads[i]->enable_output(*timer, output_interval_ms);
+
+			output_rom.construct(env, "output");
+			output_rom->sigh(output_handler);
+			handle_output();
+		}
+
 		env.parent().announce(env.ep().manage(input_root));
 	}
 };
@@ -109,7 +109,7 @@ struct Microsoft_xbox360 : Hid_device
 		log("rz:      ", Hex(n->rz),      " (", Hex(o->rz),      ")");
 	}
 
-	Microsoft_xbox360(Input::Session_component &input_session)
+	Microsoft_xbox360(Device_input &input_session)
 	: Hid_device(input_session, "Microsoft Corp. Xbox360 Controller") { }
 
 
@@ -181,6 +181,35 @@ struct Microsoft_xbox360 : Hid_device
 	uint8_t iface() const { return IFACE_NUM; }
 	uint8_t    ep() const { return EP_NUM; }
 	uint8_t   alt() const { return ALT_NUM; }
+
+	Output_transfer output_transfer() const { return OUTPUT_IRQ; }
+
+	size_t output_report(Output const &o, unsigned i, uint8_t *buf, size_t max)
+	{
+		switch (i) {
+		case 0:
+		{
+			/* rumble */
+			uint8_t const r[8] = { 0x00, 0x08, 0x00, o.strong, o.weak, 0x00, 0x00, 0x00 };
+			if (max < sizeof(r)) return 0;
+			Genode::memcpy(buf, r, sizeof(r));
+			return sizeof(r);
+		}
+		case 1:
+		{
+			/* ring of light, 0x06 to 0x09 lights the quadrant of player 1 to 4 */
+			uint8_t cmd = 0x00;
+			for (unsigned p = 0; p < 4; p++)
+				if (o.leds & (1u << p)) { cmd = 0x06 + p; break; }
+
+			uint8_t const r[3] = { 0x01, 0x03, cmd };
+			if (max < sizeof(r)) return 0;
+			Genode::memcpy(buf, r, sizeof(r));
+			return sizeof(r);
+		}
+		default: return 0;
+		}
+	}
 };
 
 #endif /* _MICROSOFT_XBOX_360_H_ */
@@ -112,7 +112,7 @@ struct Microsoft_xboxone : Hid_device
 		log("rz:        ", Hex(n->rz),        " (", Hex(o->rz),        ")");
 	}
 
-	Microsoft_xboxone(Input::Session_component &input_session)
+	Microsoft_xboxone(Device_input &input_session)
 	: Hid_device(input_session, "Microsoft Corp. Xbox One Controller") { }
 
 
@@ -192,6 +192,31 @@ struct Microsoft_xboxone : Hid_device
 	uint8_t iface() const { return IFACE_NUM; }
 	uint8_t    ep() const { return EP_NUM; }
 	uint8_t   alt() const { return ALT_NUM; }
+
+	uint8_t output_seq = 0;
+
+	Output_transfer output_transfer() const { return OUTPUT_IRQ; }
+
+	size_t output_report(Output const &o, unsigned i, uint8_t *buf, size_t max)
+	{
+		enum { CMD_RUMBLE = 0x09, MOTOR_ALL = 0x0f, };
+
+		enum { REPORT_SIZE = 13 };
+		if (i != 0 || max < REPORT_SIZE) return 0;
+
+		/* the motor strength ranges from 0 to 127 */
+		uint8_t const r[REPORT_SIZE] = {
+			CMD_RUMBLE, 0x00, output_seq, 0x09, 0x00, MOTOR_ALL,
+			0x00, 0x00,                             /* triggers  */
+			(uint8_t)(o.strong / 2), (uint8_t)(o.weak / 2),
+			0xff, 0x00, 0xff };                     /* on, off, repeat */
+
+		Genode::memcpy(buf, r, sizeof(r));
+		return sizeof(r);
+	}
+
+	/* the sequence number advances only with each transmitted report */
+	void output_submitted(unsigned) { output_seq++; }
 };
 
 #endif /* _MICROSOFT_XBOX_ONE_H_ */
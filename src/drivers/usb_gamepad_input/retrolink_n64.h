@@ -103,7 +103,7 @@ struct Retrolink_n64 : Hid_device
 
 	uint8_t last[DATA_LENGTH] = {};
 
-	Retrolink_n64(Input::Session_component &input_session)
+	Retrolink_n64(Device_input &input_session)
 	: Hid_device(input_session, "Retrolink N64 gamepad")
 	{
 
@@ -124,7 +124,7 @@ struct Sony_ds3 : Hid_device
 		log("rt:        ", Hex(n->rt),        " (", Hex(o->rt),        ")");
 	}
 
-	Sony_ds3(Input::Session_component &input_session)
+	Sony_ds3(Device_input &input_session)
 	: Hid_device(input_session, "Sony Corp. PlayStation(R) 3 Controller") { }
 
 
@@ -220,6 +220,34 @@ struct Sony_ds3 : Hid_device
 	uint8_t iface() const { return IFACE_NUM; }
 	uint8_t    ep() const { return EP_NUM; }
 	uint8_t   alt() const { return ALT_NUM; }
+
+	Output_transfer output_transfer() const { return OUTPUT_SET_REPORT; }
+
+	size_t output_report(Output const &o, unsigned i, uint8_t *buf, size_t max)
+	{
+		enum { LED_OFF = 0x00, };
+
+		/* output report 1, LED timings as used by the PS3 */
+		uint8_t r[36] = {
+			0x01,
+			0x00, 0xff, 0x00, 0xff, 0x00,  /* rumble */
+			0x00, 0x00, 0x00, 0x00,
+			LED_OFF,                       /* LED bitmap */
+			0xff, 0x27, 0x10, 0x00, 0x32,
+			0xff, 0x27, 0x10, 0x00, 0x32,
+			0xff, 0x27, 0x10, 0x00, 0x32,
+			0xff, 0x27, 0x10, 0x00, 0x32,
+			0x00, 0x00, 0x00, 0x00, 0x00 };
+
+		if (i != 0 || max < sizeof(r)) return 0;
+
+		r[3]  = o.weak ? 1 : 0;            /* the weak motor is on or off */
+		r[5]  = o.strong;
+		r[10] = (o.leds & 0xf) << 1;
+
+		Genode::memcpy(buf, r, sizeof(r));
+		return sizeof(r);
+	}
 };
 
 #endif /* _SONY_DS3_H_ */
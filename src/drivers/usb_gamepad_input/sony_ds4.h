@@ -132,7 +132,7 @@ struct Sony_ds4 : Hid_device
 		log("rt:        ", Hex(n->rt),        " (", Hex(o->rt),        ")");
 	}
 
-	Sony_ds4(Input::Session_component &input_session)
+	Sony_ds4(Device_input &input_session)
 	: Hid_device(input_session, "Sony Corp. PlayStation(R) 4 Controller")
 	{
 		last[5] = 0x08;
@@ -240,6 +240,27 @@ struct Sony_ds4 : Hid_device
 	uint8_t iface() const { return IFACE_NUM; }
 	uint8_t    ep() const { return EP_NUM; }
 	uint8_t   alt() const { return ALT_NUM; }
+
+	Output_transfer output_transfer() const { return OUTPUT_IRQ; }
+
+	size_t output_report(Output const &o, unsigned i, uint8_t *buf, size_t max)
+	{
+		enum { REPORT_ID = 0x05, RUMBLE = 0x01, LIGHTBAR = 0x02, FLASH = 0x04 };
+
+		uint8_t r[32] { };
+		if (i != 0 || max < sizeof(r)) return 0;
+
+		r[0] = REPORT_ID;
+		r[1] = RUMBLE | LIGHTBAR | FLASH;
+		r[4] = o.weak;
+		r[5] = o.strong;
+		r[6] = o.red;
+		r[7] = o.green;
+		r[8] = o.blue;
+
+		Genode::memcpy(buf, r, sizeof(r));
+		return sizeof(r);
+	}
 };
 
 #endif /* _SONY_DS4_H_ */
@@ -20,6 +20,9 @@
 #include <input/keycodes.h>
 #include <input_session/connection.h>
 
+/* local includes */
+#include <device_input.h>
+
 
 namespace Utils {
 
@@ -36,13 +39,13 @@ namespace Utils {
 	typedef signed short int16_t;
 	int16_t convert_u8_to_s16(uint8_t);
 
-	template <typename T> void check_buttons(Input::Session_component&,
+	template <typename T> void check_buttons(Device_input &,
 	                   T const, T const, uint8_t const, Input::Keycode[]);
 
-	void check_axis(Input::Session_component&,
+	void check_axis(Device_input &,
 	                int16_t const, int16_t const, int16_t const, int16_t const, int const);
 
-	void check_hat(Input::Session_component &, uint8_t const, uint8_t const);
+	void check_hat(Device_input &, uint8_t const, uint8_t const);
 }
 
 void Utils::Dump::device(Device_descriptor &descr)
@@ -97,7 +100,7 @@ Utils::int16_t Utils::convert_u8_to_s16(uint8_t val)
 
 
 template <typename T>
-void Utils::check_buttons(Input::Session_component &input_session,
+void Utils::check_buttons(Device_input &input_session,
                           T const prev, T const curr,
                           uint8_t const count, Input::Keycode mapping[])
 {
@@ -115,7 +118,7 @@ void Utils::check_buttons(Input::Session_component &input_session,
 }
 
 
-void Utils::check_axis(Input::Session_component &input_session,
+void Utils::check_axis(Device_input &input_session,
                        int16_t const ox, int16_t const nx,
                        int16_t const oy, int16_t const ny,
                        int const axis)
@@ -130,7 +133,7 @@ void Utils::check_axis(Input::Session_component &input_session,
 }
 
 
-void Utils::check_hat(Input::Session_component &input_session, uint8_t const o, uint8_t const n)
+void Utils::check_hat(Device_input &input_session, uint8_t const o, uint8_t const n)
 {
 	static struct Axis_mapping
 	{
@@ -15,36 +15,126 @@
 #include <vfs/vfs_handle.h>
 #include <base/attached_rom_dataspace.h>
 #include <base/session_label.h>
+#include <base/signal.h>
 #include <util/list.h>
 
 namespace Vfs { class Any_rom_file_system; };
 
+
+/**
+ * File system that exposes any ROM requested by name
+ *
+ * ROMs are indexed by a hash of their name. A ROM without references is
+ * not closed but kept in a pool of idle ROMs, sized by the 'idle' config
+ * attribute. The least recently used idle ROMs are closed when the pool
+ * overflows.
+ *
+ * ROMs are updated in place whenever the ROM server signals a change, so
+ * reads through open handles return the new content without reopening
+ * the file. A ROM that is mapped by a client is updated once the last
+ * mapping is released.
+ *
+ * The root directory lists the ROMs declared by '<rom name="..."/>' config
+ * nodes as well as every ROM that has been opened successfully. Clients
+ * that map a ROM obtain the ROM dataspace itself through the 'dataspace'
+ * hook, which holds a reference on the ROM until it is released.
+ */
 class Vfs::Any_rom_file_system : public File_system
 {
 	private:
 
+		enum { BUCKET_COUNT = 1024, DEFAULT_IDLE = 32 };
+
 		struct Rom : Genode::Attached_rom_dataspace, Genode::List<Rom>::Element
 		{
 			Genode::Session_label const _name;
 
+			unsigned const _hash;
+
 			int _ref_count = 0;
 
-			Rom(Genode::Env &env, Genode::Session_label const &rom_label )
-			: Attached_rom_dataspace(env, rom_label.string()), _name(rom_label.last_element()) { }
+			/* number of references held by mappings of the dataspace */
+			int _mapped = 0;
+
+			/* an update is deferred until the last mapping is released */
+			bool _stale = false;
+
+			/* links within the pool of idle ROMs, most recently used first */
+			Rom *idle_prev = nullptr;
+			Rom *idle_next = nullptr;
+
+			void _handle_update()
+			{
+				if (_mapped)
+					_stale = true;
+				else
+					update();
+			}
+
+			Genode::Signal_handler<Rom> _update_handler;
+
+			Rom(Genode::Env &env, Genode::Session_label const &rom_label,
+			    unsigned hash)
+			:
+				Attached_rom_dataspace(env, rom_label.string()),
+				_name(rom_label.last_element()), _hash(hash),
+				_update_handler(env.ep(), *this, &Rom::_handle_update)
+			{
+				sigh(_update_handler);
+
+				/* catch a change that raced with the signal registration */
+				update();
+			}
 
 			bool operator == (char const *other) const { return _name == other; }
 
-			void incr() { ++_ref_count; }
-			void decr() { --_ref_count; }
+			unsigned hash() const { return _hash; }
+
+			/**
+			 * Increment reference count, return true if the ROM was idle
+			 */
+			bool incr() { return _ref_count++ == 0; }
+
+			/**
+			 * Decrement reference count, return true if the ROM became idle
+			 */
+			bool decr() { return --_ref_count == 0; }
 
 			bool unused() const { return _ref_count <= 0; }
+
+			void map() { ++_mapped; }
+
+			void unmap()
+			{
+				if (--_mapped == 0 && _stale) {
+					_stale = false;
+					update();
+				}
+			}
+
+			bool mapped() const { return _mapped > 0; }
+		};
+
+		typedef Genode::String<Genode::Session_label::capacity()> Name;
+
+		/**
+		 * Name of a ROM known to exist, listed in the root directory
+		 */
+		struct Known_name : Genode::List<Known_name>::Element
+		{
+			Name     const name;
+			unsigned const hash;
+
+			Known_name(char const *name, unsigned hash)
+			: name(name), hash(hash) { }
 		};
 
 		class Rom_vfs_handle : public Vfs_handle
 		{
 			private:
 
-				Rom &_rom;
+				Any_rom_file_system &_fs;
+				Rom                 &_rom;
 
 			public:
 
@@ -53,10 +143,10 @@ class Vfs::Any_rom_file_system : public File_system
 				               Rom                 &rom)
 				:
 					Vfs_handle(fs, fs, alloc, OPEN_MODE_RDONLY),
-					_rom(rom)
-				{ _rom.incr(); }
+					_fs(fs), _rom(rom)
+				{ _fs._incr(_rom); }
 
-				~Rom_vfs_handle() { _rom.decr(); }
+				~Rom_vfs_handle() { _fs._decr(_rom); }
 
 				file_size read(char *buf, file_size buf_size)
 				{
@@ -71,32 +161,166 @@ class Vfs::Any_rom_file_system : public File_system
 
 		Genode::Env       &_env;
 		Genode::Allocator &_alloc;
-		Genode::List<Rom>  _roms;
+
+		/* ROMs hashed by name */
+		Genode::List<Rom> _buckets[BUCKET_COUNT];
+
+		/* ROMs without references, kept for reuse */
+		Rom *_idle_head  = nullptr;
+		Rom *_idle_tail  = nullptr;
+		unsigned _idle_count = 0;
+		unsigned const _idle_max;
+
+		/* names listed in the directory, hashed and in order of discovery */
+		Genode::List<Known_name>   _name_buckets[BUCKET_COUNT];
+		Known_name               **_names          = nullptr;
+		unsigned                   _name_count     = 0;
+		unsigned                   _name_capacity  = 0;
 
 		Genode::Session_label const _label;
 
+		static unsigned _hash(char const *name)
+		{
+			/* FNV-1a */
+			unsigned h = 2166136261U;
+			for (; *name; ++name)
+				h = (h ^ (unsigned char)*name) * 16777619U;
+			return h;
+		}
+
+		Genode::List<Rom> &_bucket(unsigned hash) {
+			return _buckets[hash % BUCKET_COUNT]; }
+
+		void _idle_remove(Rom &rom)
+		{
+			if (rom.idle_prev) rom.idle_prev->idle_next = rom.idle_next;
+			else               _idle_head = rom.idle_next;
+
+			if (rom.idle_next) rom.idle_next->idle_prev = rom.idle_prev;
+			else               _idle_tail = rom.idle_prev;
+
+			rom.idle_prev = rom.idle_next = nullptr;
+			--_idle_count;
+		}
+
+		void _idle_insert(Rom &rom)
+		{
+			rom.idle_prev = nullptr;
+			rom.idle_next = _idle_head;
+			if (_idle_head) _idle_head->idle_prev = &rom;
+			else            _idle_tail = &rom;
+			_idle_head = &rom;
+			++_idle_count;
+		}
+
+		void _destroy(Rom &rom)
+		{
+			if (rom.unused())
+				_idle_remove(rom);
+			_bucket(rom.hash()).remove(&rom);
+			Genode::destroy(_alloc, &rom);
+		}
+
+		/**
+		 * Evict the least recently used idle ROMs beyond the pool size
+		 */
+		void _trim_idle()
+		{
+			while (_idle_count > _idle_max && _idle_tail)
+				_destroy(*_idle_tail);
+		}
+
+		void _incr(Rom &rom)
+		{
+			if (rom.incr())
+				_idle_remove(rom);
+		}
+
+		void _decr(Rom &rom)
+		{
+			if (rom.decr()) {
+				_idle_insert(rom);
+				_trim_idle();
+			}
+		}
+
+		static bool _root(char const *path) {
+			return (*path == '/' && *(path+1) == '\0') || *path == '\0'; }
+
+		void _learn_name(char const *filename, unsigned hash)
+		{
+			using namespace Genode;
+
+			List<Known_name> &bucket = _name_buckets[hash % BUCKET_COUNT];
+			for (Known_name *n = bucket.first(); n; n = n->next())
+				if (n->hash == hash && n->name == filename)
+					return;
+
+			if (_name_count == _name_capacity) {
+				unsigned const capacity = max(64U, _name_capacity*2);
+				Known_name **names = (Known_name **)
+					_alloc.alloc(capacity*sizeof(Known_name *));
+				for (unsigned i = 0; i < _name_count; ++i)
+					names[i] = _names[i];
+				if (_names)
+					_alloc.free(_names, _name_capacity*sizeof(Known_name *));
+				_names = names;
+				_name_capacity = capacity;
+			}
+
+			Known_name *n = new (_alloc) Known_name(filename, hash);
+			bucket.insert(n);
+			_names[_name_count++] = n;
+		}
+
+		/**
+		 * Find a connected ROM without side effects
+		 */
+		Rom *_find(char const *filename, unsigned hash)
+		{
+			for (Rom *rom = _bucket(hash).first(); rom; rom = rom->next())
+				if (rom->hash() == hash && *rom == filename)
+					return rom;
+			return nullptr;
+		}
+
+		Rom *_find(char const *filename)
+		{
+			if (*filename == '/') ++filename;
+			return _find(filename, _hash(filename));
+		}
+
 		Rom *lookup(char const *filename)
 		{
 			using namespace Genode;
 
 			if (*filename == '/') ++filename;
 
-			for (Rom *rom = _roms.first(); rom; rom = rom->next()) {
-				if (*rom == filename) {
-					/* if the ROM dataspace is not in use, update it */
-					if (rom->unused()) {
-						_roms.remove(rom);
-						destroy(_alloc, rom);
-						/* fallthru and try again */
-					} else
-						return rom;
+			/* the root directory is not a ROM */
+			if (*filename == '\0')
+				return nullptr;
+
+			unsigned const hash = _hash(filename);
+
+			if (Rom *rom = _find(filename, hash)) {
+
+				/* the content is kept current by the update signal */
+				if (rom->unused()) {
+					_idle_remove(*rom);
+					_idle_insert(*rom);
 				}
+				return rom;
 			}
 
 			try {
 				Rom *rom = new (_alloc)
-					Rom(_env, prefixed_label(_label, Session_label(filename)));
-				_roms.insert(rom);
+					Rom(_env, prefixed_label(_label, Session_label(filename)), hash);
+				_bucket(hash).insert(rom);
+				_learn_name(filename, hash);
+
+				/* a fresh ROM is idle until referenced */
+				_idle_insert(*rom);
+				_trim_idle();
 				return rom;
 			} catch (...) { }
 			return 0;
@@ -109,25 +333,33 @@ class Vfs::Any_rom_file_system : public File_system
 		                    Genode::Xml_node node)
 		:
 			_env(env), _alloc(alloc),
-			_label(node.attribute_value("label",
-			                            Genode::String<Genode::Session_label::capacity()>()).string())
-		{ }
+			_idle_max(Genode::max(1U, node.attribute_value("idle", (unsigned)DEFAULT_IDLE))),
+			_label(node.attribute_value("label", Name()).string())
+		{
+			node.for_each_sub_node("rom", [&] (Genode::Xml_node rom) {
+				Name const name = rom.attribute_value("name", Name());
+				if (name.valid())
+					_learn_name(name.string(), _hash(name.string()));
+			});
+		}
 
 		/*********************************
 		 ** Directory-service interface **
 		 *********************************/
 
-		file_size num_dirent(char const *path) override { return 0; }
+		file_size num_dirent(char const *path) override {
+			return _root(path) ? _name_count : 0; }
 
-		bool directory(char const *path) override { return false; }
+		bool directory(char const *path) override { return _root(path); }
 
 		char const *leaf_path(char const *path) override {
-			return lookup(path) ? path : 0; }
+			return (_root(path) || lookup(path)) ? path : 0; }
 
 		Dataspace_capability dataspace(char const *path) override
 		{
 			if (Rom *rom = lookup(path)) {
-				rom->incr();
+				_incr(*rom);
+				rom->map();
 				return rom->cap();
 			}
 			return Dataspace_capability();
@@ -136,8 +368,12 @@ class Vfs::Any_rom_file_system : public File_system
 		void release(char const *path,
 		             Dataspace_capability ds_cap) override
 		{
-			if (Rom *rom = lookup(path))
-				rom->decr();
+			/* the reference taken by 'dataspace' keeps the ROM connected */
+			if (Rom *rom = _find(path))
+				if (rom->mapped()) {
+					rom->unmap();
+					_decr(*rom);
+				}
 		}
 
 		Open_result open(char        const *path,
@@ -171,23 +407,46 @@ class Vfs::Any_rom_file_system : public File_system
 		Stat_result stat(char const *path, Stat &stat) override
 		{
 			stat = Stat();
+
+			if (_root(path)) {
+				stat.mode = STAT_MODE_DIRECTORY | 0555;
+				return STAT_OK;
+			}
+
 			Rom *rom = lookup(path);
 			if (!rom) return STAT_ERR_NO_ENTRY;
 
+			stat.mode = STAT_MODE_FILE | 0444;
 			stat.size = rom->size();
 			return STAT_OK;
 		}
 
-		Dirent_result dirent(char const *, file_offset, Dirent &dirent) override {
-			return DIRENT_ERR_INVALID_PATH; }
+		Dirent_result dirent(char const *path, file_offset index,
+		                     Dirent &dirent) override
+		{
+			if (!_root(path))
+				return DIRENT_ERR_INVALID_PATH;
+
+			dirent = Dirent();
+
+			if (index < 0 || (unsigned long long)index >= _name_count) {
+				dirent.type = DIRENT_TYPE_END;
+				return DIRENT_OK;
+			}
+
+			Known_name const &n = *_names[index];
+			dirent.fileno = index + 1;
+			dirent.type   = DIRENT_TYPE_FILE;
+			Genode::strncpy(dirent.name, n.name.string(), sizeof(dirent.name));
+			return DIRENT_OK;
+		}
 
 		Unlink_result unlink(char const *path)
 		{
 			if (Rom *rom = lookup(path)) {
 				if (rom->unused()) {
 					/* why not free some memory */
-					_roms.remove(rom);
-					destroy(_alloc, rom);
+					_destroy(*rom);
 					return UNLINK_OK;
 				}
 				return UNLINK_ERR_NO_PERM;
@@ -217,15 +476,8 @@ class Vfs::Any_rom_file_system : public File_system
 		 */
 		void sync(char const *path) override
 		{
-			for (Rom *rom = _roms.first(); rom;) {
-				if (rom->unused()) {
-					_roms.remove(rom);
-					destroy(_alloc, rom);
-					rom = _roms.first();
-				} else {
-					rom = rom->next();
-				}
-			}
+			while (_idle_tail)
+				_destroy(*_idle_tail);
 		}
 
 		/**********************
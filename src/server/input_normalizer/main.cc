@@ -16,17 +16,133 @@
 #include <timer_session/connection.h>
 #include <input/component.h>
 #include <input/event_queue.h>
+#include <input/keycodes.h>
 #include <input_session/connection.h>
 #include <os/static_root.h>
+#include <os/reporter.h>
 #include <base/component.h>
 #include <base/attached_rom_dataspace.h>
 #include <base/attached_dataspace.h>
 
 namespace Input_normalizer {
 	using namespace Genode;
+
+	enum Event_class { KEY, BUTTON, MOTION, WHEEL, TOUCH, OTHER, NUM_CLASSES };
+
+	static char const *class_name(unsigned c)
+	{
+		static char const *names[NUM_CLASSES] =
+			{ "key", "button", "motion", "wheel", "touch", "other" };
+		return c < NUM_CLASSES ? names[c] : "";
+	}
+
+	static Event_class classify(Input::Event const &e);
+
+	struct Class_policy;
+	struct Latency_histogram;
 	struct Main;
 }
 
+
+Input_normalizer::Event_class Input_normalizer::classify(Input::Event const &e)
+{
+	using namespace Input;
+
+	if (e.press() || e.release()) {
+		Keycode key = KEY_UNKNOWN;
+		e.handle_press([&] (Keycode k, Codepoint) { key = k; });
+		e.handle_release([&] (Keycode k) { key = k; });
+		return (key >= BTN_MISC && key < KEY_OK) ? BUTTON : KEY;
+	}
+
+	if (e.absolute_motion() || e.relative_motion()) return MOTION;
+	if (e.wheel())                                  return WHEEL;
+	if (e.touch() || e.touch_release())             return TOUCH;
+
+	return OTHER;
+}
+
+
+/**
+ * Delivery deadline of one class of events
+ *
+ * With 'adaptive' set, the batch window follows twice the mean
+ * inter-arrival time of the class, bounded by 'min_ms' and the deadline.
+ * Sparse events are thereby held for the full deadline while bursts are
+ * delivered as soon as they are likely to be complete.
+ */
+struct Input_normalizer::Class_policy
+{
+	uint64_t deadline_us = 0;
+	uint64_t min_us      = 0;
+	bool     adaptive    = false;
+
+	uint64_t last_arrival_us = 0;
+	uint64_t mean_gap_us     = 0;
+
+	void configure(Xml_node node)
+	{
+		deadline_us = node.attribute_value("deadline_ms", (unsigned)(deadline_us/1000))*1000ULL;
+		min_us      = node.attribute_value("min_ms",      (unsigned)(min_us/1000))*1000ULL;
+		adaptive    = node.attribute_value("adaptive",    adaptive);
+	}
+
+	void arrival(uint64_t now_us)
+	{
+		if (last_arrival_us) {
+			uint64_t const gap = now_us - last_arrival_us;
+			/* exponentially weighted moving average, alpha = 1/8 */
+			mean_gap_us = mean_gap_us
+				? mean_gap_us - mean_gap_us/8 + gap/8 : gap;
+		}
+		last_arrival_us = now_us;
+	}
+
+	uint64_t window_us() const
+	{
+		if (!adaptive || !mean_gap_us)
+			return deadline_us;
+
+		return min(deadline_us, max(min_us, 2*mean_gap_us));
+	}
+};
+
+
+/**
+ * Distribution of delivery latencies in milliseconds
+ */
+struct Input_normalizer::Latency_histogram
+{
+	enum { BUCKETS = 1000 };
+
+	unsigned long counts[BUCKETS + 1] { };
+	unsigned long total = 0;
+
+	void record(uint64_t latency_us)
+	{
+		uint64_t const ms = latency_us / 1000;
+		++counts[ms < BUCKETS ? ms : BUCKETS];
+		++total;
+	}
+
+	/**
+	 * Return the latency in milliseconds below which 'permille' of the
+	 * events were delivered
+	 */
+	unsigned percentile(unsigned permille) const
+	{
+		unsigned long const threshold = (total*permille + 999) / 1000;
+		unsigned long sum = 0;
+		for (unsigned i = 0; i <= BUCKETS; ++i) {
+			sum += counts[i];
+			if (sum >= threshold)
+				return i;
+		}
+		return BUCKETS;
+	}
+};
+
+
 /******************
  ** Main program **
  ******************/
@@ -35,20 +151,49 @@ struct Input_normalizer::Main
 {
 	Genode::Env &env;
 
-	unsigned config_period_ms()
+	enum { DEFAULT_PERIOD_MS = 200, MAX_PENDING = 256 };
+
+	Class_policy policies[NUM_CLASSES];
+
+	bool coalesce_motion = true;
+
+	bool report_latency = false;
+
+	void apply_config()
 	{
-		enum { DEFAULT_PERIOD_MS = 200 };
-		unsigned value = DEFAULT_PERIOD_MS;
+		unsigned period_ms = DEFAULT_PERIOD_MS;
 
 		try {
 			Attached_rom_dataspace config { env, "config" };
-			config.xml().attribute("period_ms").value(&value);
-		} catch (...) { }
-		return value;
-	}
+			Xml_node const node = config.xml();
+
+			period_ms       = node.attribute_value("period_ms", period_ms);
+			coalesce_motion = node.attribute_value("coalesce_motion", coalesce_motion);
 
-	Microseconds const period_us =
-		Microseconds{config_period_ms() * 1000};
+			/*
+			 * By default, key and button events are held for the period
+			 * while all other events are delivered immediately.
+			 */
+			policies[KEY].deadline_us    = period_ms*1000ULL;
+			policies[BUTTON].deadline_us = period_ms*1000ULL;
+
+			node.for_each_sub_node("policy", [&] (Xml_node policy) {
+				typedef String<16> Name;
+				Name const name = policy.attribute_value("class", Name());
+				for (unsigned c = 0; c < NUM_CLASSES; ++c)
+					if (name == class_name(c))
+						policies[c].configure(policy);
+			});
+
+			if (node.has_sub_node("report"))
+				report_latency = node.sub_node("report")
+					.attribute_value("latency", false);
+
+		} catch (...) {
+			policies[KEY].deadline_us    = period_ms*1000ULL;
+			policies[BUTTON].deadline_us = period_ms*1000ULL;
+		}
+	}
 
 	/* input session provided by our parent  */
 	Input::Connection parent_input { env };
@@ -65,51 +210,140 @@ struct Input_normalizer::Main
 	/* Timer session for delaying events */
 	Timer::Connection timer { env };
 
+	uint64_t now_us() { return timer.curr_time().trunc_to_plain_us().value; }
+
+	/* events held back until their deadline */
+	struct Pending
+	{
+		Input::Event event;
+		uint64_t     arrival_us;
+		unsigned     cls;
+	} pending[MAX_PENDING];
+
+	unsigned pending_count = 0;
+
+	/* earliest deadline among the pending events */
+	uint64_t flush_at_us = ~0ULL;
+
+	Latency_histogram latency[NUM_CLASSES];
+
+	bool latency_changed = false;
+
+	Reporter latency_reporter { env, "latency" };
+
+	void flush(uint64_t now)
+	{
+		if (!pending_count)
+			return;
+
+		enum { SUBMIT_NOW = false };
+		for (unsigned i = 0; i < pending_count; ++i) {
+			queue.add(pending[i].event, SUBMIT_NOW);
+			if (report_latency)
+				latency[pending[i].cls].record(now - pending[i].arrival_us);
+		}
+		queue.submit_signal();
+
+		pending_count   = 0;
+		flush_at_us     = ~0ULL;
+		latency_changed = report_latency;
+	}
+
 	/* submit after delay */
 	void handle_timeout(Duration)
 	{
-		if (!queue.empty())
-			queue.submit_signal();
+		flush(now_us());
 	}
 
 	Timer::One_shot_timeout<Main> burst_timeout =
 		{ timer, *this, &Main::handle_timeout };
 
+	void enqueue(Input::Event const &e, uint64_t now)
+	{
+		unsigned const cls = classify(e);
+
+		/* replace a pending absolute motion by the latest position */
+		if (coalesce_motion && e.absolute_motion() && pending_count
+		 && pending[pending_count-1].event.absolute_motion()) {
+			pending[pending_count-1].event = e;
+			return;
+		}
+
+		if (pending_count == MAX_PENDING)
+			flush(now);
+
+		policies[cls].arrival(now);
+
+		pending[pending_count++] = Pending { e, now, cls };
+		flush_at_us = min(flush_at_us, now + policies[cls].window_us());
+	}
+
 	/* signaled by input signal */
 	void handle_input()
 	{
 		using namespace Input;
 
-		/*
-		 * laggy pointing is upleasant, so signal downstream if
-		 * there is anything other than button presses upstream,
-		 * otherwise notify downstream after a timeout
-		 */
-		bool notify = false;
+		uint64_t const now = now_us();
 
 		parent_input.for_each_event([&] (Event const &e) {
-			if (!e.press() && !e.release())
-				notify = true;
-			enum { SUBMIT_NOW = false };
-			queue.add(e, SUBMIT_NOW);
-		});
+			enqueue(e, now); });
 
-		if (notify) {
-			queue.submit_signal();
+		/*
+		 * laggy pointing is upleasant, so events with a zero deadline,
+		 * by default everything but key and button events, are
+		 * signaled downstream immediately along with any pending
+		 * events, otherwise notify downstream at the earliest deadline
+		 */
+		if (flush_at_us <= now) {
+			flush(now);
 			burst_timeout.discard();
-		} else if (!burst_timeout.scheduled()) {
-			burst_timeout.schedule(period_us);
+		} else if (pending_count) {
+			burst_timeout.schedule(Microseconds { flush_at_us - now });
 		}
 	}
 
 	Signal_handler<Main> input_handler =
 		{ env.ep(), *this, &Main::handle_input };
 
+	void report(Duration)
+	{
+		if (!latency_changed)
+			return;
+		latency_changed = false;
+
+		Reporter::Xml_generator xml(latency_reporter, [&] () {
+			for (unsigned c = 0; c < NUM_CLASSES; ++c) {
+				Latency_histogram const &h = latency[c];
+				if (!h.total)
+					continue;
+
+				xml.node(class_name(c), [&] () {
+					xml.attribute("events", h.total);
+					xml.attribute("p50_ms", h.percentile(500));
+					xml.attribute("p90_ms", h.percentile(900));
+					xml.attribute("p99_ms", h.percentile(990));
+					xml.attribute("max_ms", h.percentile(1000));
+					xml.attribute("window_ms", policies[c].window_us()/1000);
+				});
+			}
+		});
+	}
+
+	Constructible<Timer::Periodic_timeout<Main>> report_timeout { };
+
 	/**
 	 * Constructor
 	 */
 	Main(Genode::Env &env) : env(env)
 	{
+		apply_config();
+
+		if (report_latency) {
+			latency_reporter.enabled(true);
+			report_timeout.construct(timer, *this, &Main::report,
+			                         Microseconds { 1000*1000 });
+		}
+
 		queue.enabled(true);
 
 		/* register input handler */
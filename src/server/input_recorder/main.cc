@@ -0,0 +1,112 @@
+/*
+ * \brief  Input filter that records the passing events to a file
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+/* Genode includes */
+#include <timer_session/connection.h>
+#include <input/component.h>
+#include <input/event_queue.h>
+#include <input_session/connection.h>
+#include <input_record/format.h>
+#include <os/static_root.h>
+#include <base/attached_rom_dataspace.h>
+#include <libc/component.h>
+
+/* libc includes */
+#include <stdio.h>
+
+namespace Input_recorder {
+	using namespace Genode;
+	struct Main;
+}
+
+
+struct Input_recorder::Main
+{
+	Libc::Env &env;
+
+	typedef String<256> Path;
+
+	Attached_rom_dataspace config_rom { env, "config" };
+
+	Path const path =
+		config_rom.xml().attribute_value("file", Path("/input.rec"));
+
+	FILE *file = nullptr;
+
+	/* input session provided by our parent  */
+	Input::Connection parent_input { env };
+
+	/* input session provided to our client  */
+	Input::Session_component client_input { env, env.ram() };
+
+	Input::Event_queue &queue = client_input.event_queue();
+
+	/*  attach root interface to the entry point */
+	Static_root<Input::Session> input_root
+		{ env.ep().manage(client_input) };
+
+	Timer::Connection timer { env };
+
+	uint64_t start_us = 0;
+
+	unsigned long recorded = 0;
+
+	void handle_input()
+	{
+		uint64_t const now_us = timer.curr_time().trunc_to_plain_us().value;
+		if (!start_us)
+			start_us = now_us;
+
+		Libc::with_libc([&] () {
+			parent_input.for_each_event([&] (Input::Event const &ev) {
+				enum { SUBMIT_NOW = false };
+				queue.add(ev, SUBMIT_NOW);
+
+				Input_record::Line const line =
+					Input_record::line(now_us - start_us, ev);
+				if (line.valid() && file) {
+					fputs(line.string(), file);
+					++recorded;
+				}
+			});
+
+			/* make the recording durable once per batch */
+			if (file)
+				fflush(file);
+		});
+
+		queue.submit_signal();
+	}
+
+	Signal_handler<Main> input_handler =
+		{ env.ep(), *this, &Main::handle_input };
+
+	Main(Libc::Env &env) : env(env)
+	{
+		Libc::with_libc([&] () {
+			file = fopen(path.string(), "w"); });
+
+		if (!file)
+			error("failed to open '", path, "', not recording");
+
+		queue.enabled(true);
+
+		parent_input.sigh(input_handler);
+
+		env.parent().announce(env.ep().manage(input_root));
+	}
+};
+
+
+void Libc::Component::construct(Libc::Env &env) {
+	static Input_recorder::Main inst(env); }
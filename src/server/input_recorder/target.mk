@@ -0,0 +1,5 @@
+TARGET = input_recorder
+SRC_CC = main.cc
+LIBS   = base libc
+
+CC_CXX_WARN_STRICT =
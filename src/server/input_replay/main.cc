@@ -0,0 +1,272 @@
+/*
+ * \brief  Replay of recorded input events with latency measurement
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+/* Genode includes */
+#include <timer_session/connection.h>
+#include <input/component.h>
+#include <input/event_queue.h>
+#include <input_session/connection.h>
+#include <input_record/format.h>
+#include <os/static_root.h>
+#include <base/attached_rom_dataspace.h>
+#include <base/heap.h>
+#include <libc/component.h>
+
+/* libc includes */
+#include <stdio.h>
+
+namespace Input_replay {
+	using namespace Genode;
+	struct Record;
+	struct Main;
+}
+
+
+struct Input_replay::Record
+{
+	uint64_t     time_us    = 0;
+	Input::Event event      { };
+	uint64_t     injected_us = 0;
+};
+
+
+struct Input_replay::Main
+{
+	Libc::Env &env;
+
+	enum { LATENCY_BUCKETS = 1000 };
+
+	typedef String<256> Path;
+
+	Attached_rom_dataspace config_rom { env, "config" };
+
+	Xml_node const config = config_rom.xml();
+
+	Path const path = config.attribute_value("file", Path("/input.rec"));
+
+	bool const measure = config.attribute_value("measure", false);
+
+	unsigned const connect_delay_ms =
+		config.attribute_value("connect_delay_ms", 1000U);
+
+	unsigned const settle_ms = config.attribute_value("settle_ms", 1000U);
+
+	Heap heap { env.ram(), env.rm() };
+
+	Record  *records      = nullptr;
+	unsigned record_count = 0;
+
+	/* input session provided to our client */
+	Input::Session_component client_input { env, env.ram() };
+
+	Input::Event_queue &queue = client_input.event_queue();
+
+	Static_root<Input::Session> input_root
+		{ env.ep().manage(client_input) };
+
+	Timer::Connection timer { env };
+
+	uint64_t now_us() { return timer.curr_time().trunc_to_plain_us().value; }
+
+	/* input session of the filter chain under test */
+	Constructible<Input::Connection> measured_input { };
+
+	uint64_t start_us = 0;
+	unsigned next     = 0;
+
+	/* position of the next record expected to arrive */
+	unsigned      match      = 0;
+	unsigned long received   = 0;
+	unsigned long matched    = 0;
+	uint64_t      last_arrival_us = 0;
+
+	unsigned long latency[LATENCY_BUCKETS + 1] { };
+
+	void load()
+	{
+		Libc::with_libc([&] () {
+			FILE *file = fopen(path.string(), "r");
+			if (!file) {
+				error("failed to open '", path, "'");
+				return;
+			}
+
+			unsigned capacity = 0;
+			char buf[128];
+			while (fgets(buf, sizeof(buf), file)) {
+				Record r;
+				if (!Input_record::parse(buf, r.time_us, r.event))
+					continue;
+
+				if (record_count == capacity) {
+					unsigned const grown_capacity = max(1024U, capacity*2);
+					Record *grown = (Record *)
+						heap.alloc(grown_capacity*sizeof(Record));
+					if (records) {
+						memcpy(grown, records, record_count*sizeof(Record));
+						heap.free(records, capacity*sizeof(Record));
+					}
+					records  = grown;
+					capacity = grown_capacity;
+				}
+				records[record_count++] = r;
+			}
+			fclose(file);
+		});
+
+		/*
+		 * The replay relies on non-decreasing times. Restore the order of
+		 * hand-written recordings by a stable insertion sort, which is
+		 * linear for recordings that are already ordered.
+		 */
+		unsigned unordered = 0;
+		for (unsigned i = 1; i < record_count; i++) {
+			if (records[i].time_us >= records[i - 1].time_us)
+				continue;
+
+			++unordered;
+			Record const r = records[i];
+			unsigned j = i;
+			for (; j > 0 && records[j - 1].time_us > r.time_us; j--)
+				records[j] = records[j - 1];
+			records[j] = r;
+		}
+		if (unordered)
+			warning(unordered, " events of '", path, "' were out of time order");
+
+		log("loaded ", record_count, " events from '", path, "'");
+	}
+
+	void inject(Duration)
+	{
+		uint64_t const now = now_us();
+
+		enum { SUBMIT_NOW = false };
+		bool submitted = false;
+		while (next < record_count && start_us + records[next].time_us <= now) {
+			records[next].injected_us = now;
+			queue.add(records[next].event, SUBMIT_NOW);
+			submitted = true;
+			++next;
+		}
+		if (submitted)
+			queue.submit_signal();
+
+		if (next < record_count)
+			replay_timeout.schedule(Microseconds {
+				start_us + records[next].time_us - now });
+		else
+			done_timeout.schedule(Microseconds { settle_ms*1000ULL });
+	}
+
+	Timer::One_shot_timeout<Main> replay_timeout =
+		{ timer, *this, &Main::inject };
+
+	void handle_measured_input()
+	{
+		uint64_t const now = now_us();
+
+		measured_input->for_each_event([&] (Input::Event const &ev) {
+			++received;
+
+			/*
+			 * Events may be coalesced by the filter under test, so
+			 * records without a matching event are skipped.
+			 */
+			for (unsigned i = match; i < next; ++i) {
+				if (!Input_record::same(ev, records[i].event))
+					continue;
+
+				uint64_t const ms = (now - records[i].injected_us) / 1000;
+				++latency[ms < LATENCY_BUCKETS ? ms : LATENCY_BUCKETS];
+				++matched;
+				match = i + 1;
+				last_arrival_us = now;
+				break;
+			}
+		});
+	}
+
+	Signal_handler<Main> measured_input_handler =
+		{ env.ep(), *this, &Main::handle_measured_input };
+
+	unsigned percentile(unsigned permille) const
+	{
+		unsigned long const threshold = (matched*permille + 999) / 1000;
+		unsigned long sum = 0;
+		for (unsigned i = 0; i <= LATENCY_BUCKETS; ++i) {
+			sum += latency[i];
+			if (sum >= threshold)
+				return i;
+		}
+		return LATENCY_BUCKETS;
+	}
+
+	void done(Duration)
+	{
+		if (measure) {
+			uint64_t const duration_us = last_arrival_us > start_us
+			                           ? last_arrival_us - start_us : 0;
+			unsigned long const events_per_s = duration_us
+				? (unsigned long)(received * 1000000ULL / duration_us) : 0;
+
+			log("injected ", record_count, " events, received ", received,
+			    ", matched ", matched, ", ", events_per_s, " events/s");
+			log("latency p50=", percentile(500), "ms p90=", percentile(900),
+			    "ms p99=", percentile(990), "ms max=", percentile(1000), "ms");
+
+			log("latency histogram:");
+			for (unsigned i = 0; i <= LATENCY_BUCKETS; ++i)
+				if (latency[i])
+					log(i < LATENCY_BUCKETS ? "  " : "  >=", i, " ms: ", latency[i]);
+		}
+
+		log("replay done");
+	}
+
+	Timer::One_shot_timeout<Main> done_timeout =
+		{ timer, *this, &Main::done };
+
+	void start(Duration)
+	{
+		/*
+		 * The filter chain under test is connected late because it
+		 * depends on our own Input service.
+		 */
+		if (measure) {
+			measured_input.construct(env, "measure");
+			measured_input->sigh(measured_input_handler);
+		}
+
+		start_us = now_us();
+		inject(Duration(Microseconds(start_us)));
+	}
+
+	Timer::One_shot_timeout<Main> start_timeout =
+		{ timer, *this, &Main::start };
+
+	Main(Libc::Env &env) : env(env)
+	{
+		load();
+
+		queue.enabled(true);
+
+		env.parent().announce(env.ep().manage(input_root));
+
+		start_timeout.schedule(Microseconds { connect_delay_ms*1000ULL });
+	}
+};
+
+
+void Libc::Component::construct(Libc::Env &env) {
+	static Input_replay::Main inst(env); }
@@ -0,0 +1,266 @@
+/*
+ * \brief  Binary timestamped capture of log streams
+ * \author agent
+ * \date   2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#ifndef _LOG_TEE__CAPTURE_H_
+#define _LOG_TEE__CAPTURE_H_
+
+/* Genode includes */
+#include <file_system_session/connection.h>
+#include <file_system/util.h>
+#include <timer_session/connection.h>
+#include <base/allocator_avl.h>
+#include <base/session_label.h>
+#include <base/semaphore.h>
+#include <base/thread.h>
+#include <base/log.h>
+#include <os/path.h>
+
+namespace Log_tee {
+
+	using namespace Genode;
+
+	class Capture;
+}
+
+
+/**
+ * Capture of log messages to a fixed-size ring within a file
+ *
+ * The file layout is decoded by 'tool/log_tee_capture'. All integers are
+ * stored in the native byte order of the capturing machine.
+ *
+ * ! Header   64 bytes
+ * ! Labels   'label_count' entries of 'label_size' bytes
+ * ! Slots    'slot_count' entries of 'slot_size' bytes
+ *
+ * A message occupies the slot 'seq % slot_count'. Sequence numbers start
+ * at one, an empty slot has a sequence number of zero. Messages dropped
+ * due to queue overflow show up as gaps in the sequence.
+ */
+class Log_tee::Capture : Thread
+{
+	public:
+
+		enum {
+			VERSION       = 1,
+			SLOT_SIZE     = 256,
+			LABEL_SIZE    = Session_label::capacity(),
+			NO_LABEL      = 0xffff,
+			DEFAULT_SLOTS = 4096,
+			DEFAULT_LABELS = 64,
+			DEFAULT_QUEUE = 64,
+			STACK_SIZE    = 4*1024*sizeof(addr_t)
+		};
+
+		struct Header
+		{
+			char     magic[8];
+			uint32_t version;
+			uint32_t slot_size;
+			uint32_t slot_count;
+			uint32_t label_count;
+			uint32_t label_size;
+			uint32_t reserved;
+			char     origin[32];
+		};
+
+		struct Slot
+		{
+			uint64_t timestamp_us;
+			uint64_t seq;
+			uint16_t label_id;
+			uint16_t length;
+			uint32_t reserved;
+			char     data[SLOT_SIZE - 24];
+		};
+
+		typedef String<32> Origin;
+
+	private:
+
+		static_assert(sizeof(Header) == 64,        "unexpected header size");
+		static_assert(sizeof(Slot)   == SLOT_SIZE, "unexpected slot size");
+
+		typedef String<LABEL_SIZE>       Label;
+		typedef String<File_system::MAX_PATH_LEN> Path;
+
+		Allocator_avl           _fs_block_alloc;
+		File_system::Connection _fs;
+		File_system::File_handle _handle;
+
+		Timer::Connection &_timer;
+
+		unsigned const _slot_count;
+		unsigned const _label_count;
+		unsigned const _capacity;
+
+		Label  * const _labels;
+		unsigned       _labels_used    = 0;
+		unsigned       _labels_written = 0;
+
+		Slot   * const _queue;
+		unsigned       _head = 0;
+		unsigned       _tail = 0;
+
+		uint64_t _seq = 0;
+
+		Lock      _lock    { };
+		Semaphore _pending { };
+
+		File_system::seek_off_t _label_offset(unsigned id) const {
+			return sizeof(Header) + (File_system::seek_off_t)id*LABEL_SIZE; }
+
+		File_system::seek_off_t _slot_offset(uint64_t seq) const {
+			return _label_offset(_label_count)
+			     + (seq % _slot_count)*SLOT_SIZE; }
+
+		static File_system::File_handle _open(File_system::Session &fs,
+		                                      Path const &path)
+		{
+			using namespace File_system;
+
+			Genode::Path<MAX_PATH_LEN> dir_path(path.string());
+			dir_path.strip_last_element();
+			Genode::Path<MAX_PATH_LEN> file_name(path.string());
+			file_name.keep_only_last_element();
+
+			Dir_handle dir = ensure_dir(fs, dir_path.base());
+			Handle_guard dir_guard(fs, dir);
+
+			try {
+				return fs.file(dir, file_name.base()+1, WRITE_ONLY, true); }
+			catch (Node_already_exists) {
+				return fs.file(dir, file_name.base()+1, WRITE_ONLY, false); }
+		}
+
+		void entry() override
+		{
+			for (;;) {
+				_pending.down();
+
+				Label label;
+				Slot  slot;
+				bool  is_label = false;
+				unsigned label_id = 0;
+				{
+					Lock::Guard guard(_lock);
+					if (_labels_written < _labels_used) {
+						label_id = _labels_written++;
+						label    = _labels[label_id];
+						is_label = true;
+					} else {
+						slot  = _queue[_tail];
+						_tail = (_tail + 1) % _capacity;
+					}
+				}
+
+				if (is_label) {
+					char buf[LABEL_SIZE] { };
+					memcpy(buf, label.string(), label.length());
+					File_system::write(_fs, _handle, buf, sizeof(buf),
+					                   _label_offset(label_id));
+				} else {
+					File_system::write(_fs, _handle, &slot, sizeof(slot),
+					                   _slot_offset(slot.seq));
+				}
+			}
+		}
+
+	public:
+
+		Capture(Env &env, Allocator &alloc, Timer::Connection &timer,
+		        Xml_node node)
+		:
+			Thread(env, "capture", STACK_SIZE),
+			_fs_block_alloc(&alloc),
+			_fs(env, _fs_block_alloc, "capture"),
+			_handle(_open(_fs, node.attribute_value("path", Path("/log_tee.cap")))),
+			_timer(timer),
+			_slot_count (max(1U, node.attribute_value("slots",  (unsigned)DEFAULT_SLOTS))),
+			_label_count(min((unsigned)NO_LABEL,
+			                 node.attribute_value("labels", (unsigned)DEFAULT_LABELS))),
+			_capacity   (max(2U, node.attribute_value("queue",  (unsigned)DEFAULT_QUEUE))),
+			_labels(new (alloc) Label[_label_count]),
+			_queue (new (alloc) Slot[_capacity])
+		{
+			/* discard the previous capture and reserve the complete ring */
+			_fs.truncate(_handle, 0);
+			_fs.truncate(_handle, _slot_offset(0) + (File_system::file_size_t)
+			                      _slot_count*SLOT_SIZE);
+
+			Header header { };
+			memcpy(header.magic, "LTEECAP1", sizeof(header.magic));
+			header.version     = VERSION;
+			header.slot_size   = SLOT_SIZE;
+			header.slot_count  = _slot_count;
+			header.label_count = _label_count;
+			header.label_size  = LABEL_SIZE;
+
+			Origin const origin = node.attribute_value("origin", Origin("log_tee"));
+			memcpy(header.origin, origin.string(), origin.length());
+
+			File_system::write(_fs, _handle, &header, sizeof(header), 0);
+
+			start();
+		}
+
+		/**
+		 * Return the ID of a label, registering it if necessary
+		 */
+		unsigned label_id(Session_label const &label)
+		{
+			Lock::Guard guard(_lock);
+
+			for (unsigned i = 0; i < _labels_used; ++i)
+				if (_labels[i] == label)
+					return i;
+
+			if (_labels_used == _label_count)
+				return NO_LABEL;
+
+			_labels[_labels_used] = Label(label);
+			_pending.up();
+			return _labels_used++;
+		}
+
+		/**
+		 * Queue a message for capture, never blocks
+		 */
+		void submit(unsigned label_id, Log_session::String const &msg)
+		{
+			uint64_t const now_us = _timer.curr_time().trunc_to_plain_us().value;
+
+			Lock::Guard guard(_lock);
+
+			uint64_t const seq = ++_seq;
+
+			unsigned const next = (_head + 1) % _capacity;
+			if (next == _tail)
+				return;
+
+			Slot &slot = _queue[_head];
+			size_t const len = min(strlen(msg.string()), sizeof(slot.data));
+
+			slot.timestamp_us = now_us;
+			slot.seq          = seq;
+			slot.label_id     = label_id;
+			slot.length       = len;
+			slot.reserved     = 0;
+			memcpy(slot.data, msg.string(), len);
+
+			_head = next;
+			_pending.up();
+		}
+};
+
+#endif /* _LOG_TEE__CAPTURE_H_ */
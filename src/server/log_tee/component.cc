@@ -13,22 +13,220 @@
 
 /* Genode includes */
 #include <log_session/connection.h>
+#include <timer_session/connection.h>
 #include <root/component.h>
+#include <base/attached_rom_dataspace.h>
 #include <base/component.h>
 #include <base/session_label.h>
+#include <base/semaphore.h>
+#include <base/thread.h>
 #include <base/heap.h>
 #include <base/log.h>
 #include <util/list.h>
 
+/* local includes */
+#include "capture.h"
+
 namespace Log_tee {
 
 	using namespace Genode;
+	class Sink;
 	class Session_component;
 	class Root_component;
 
+	typedef List<Sink> Sink_list;
 }
 
 
+/**
+ * Asynchronous destination for duplicated log messages
+ *
+ * Each sink owns a LOG session to the parent, labeled with the sink
+ * name, and a thread that drains a bounded message queue into that
+ * session. Messages are enqueued without blocking, so a slow sink
+ * drops messages rather than stalling the clients or the other sinks.
+ */
+class Log_tee::Sink : public Sink_list::Element, Thread
+{
+	public:
+
+		typedef String<64> Name;
+
+	private:
+
+		typedef String<Log_session::MAX_STRING_LEN> Line;
+		typedef String<Session_label::capacity()>   Label;
+
+		enum { DEFAULT_QUEUE = 64, STACK_SIZE = 4*1024*sizeof(addr_t) };
+
+		Name const _name;
+
+		Log_connection _log;
+
+		/* label filter, matched like a session policy */
+		Label const _label;
+		Label const _label_prefix;
+		Label const _label_suffix;
+
+		/* message filter, plain substring match */
+		Line const _contains;
+
+		/* rate limit in messages per second, zero is unlimited */
+		unsigned const _rate;
+		unsigned long  _bucket_start_ms = 0;
+		unsigned       _bucket_count    = 0;
+		unsigned long  _rate_dropped    = 0;
+
+		unsigned const _capacity;
+		Line   * const _queue;
+		unsigned       _head = 0;
+		unsigned       _tail = 0;
+		unsigned long  _overflow_dropped = 0;
+
+		Lock      _lock { };
+		Semaphore _pending { };
+
+		static bool _contains_substring(char const *s, char const *sub)
+		{
+			size_t const len = strlen(sub);
+			for (; *s; ++s)
+				if (strcmp(s, sub, len) == 0)
+					return true;
+			return false;
+		}
+
+		bool _label_matches(Session_label const &label) const
+		{
+			if (_label.valid() && label != _label)
+				return false;
+
+			if (_label_prefix.valid()
+			 && strcmp(label.string(), _label_prefix.string(),
+			           _label_prefix.length()-1) != 0)
+				return false;
+
+			if (_label_suffix.valid()) {
+				size_t const len = label.length()-1;
+				size_t const suffix_len = _label_suffix.length()-1;
+				if (suffix_len > len
+				 || strcmp(label.string()+len-suffix_len,
+				           _label_suffix.string()) != 0)
+					return false;
+			}
+
+			return true;
+		}
+
+		/**
+		 * Return true if the message is within the rate limit
+		 */
+		bool _admit(unsigned long now_ms)
+		{
+			if (!_rate)
+				return true;
+
+			if (now_ms - _bucket_start_ms >= 1000) {
+				_bucket_start_ms = now_ms;
+				_bucket_count    = 0;
+			}
+
+			if (_bucket_count >= _rate) {
+				++_rate_dropped;
+				return false;
+			}
+
+			++_bucket_count;
+			return true;
+		}
+
+		/**
+		 * Return true if the queue is full, must be called with '_lock' held
+		 */
+		bool _full() const { return (_head + 1) % _capacity == _tail; }
+
+		/**
+		 * Enqueue a line, must be called with '_lock' held
+		 */
+		void _enqueue(Line const &line)
+		{
+			if (_full()) {
+				++_overflow_dropped;
+				return;
+			}
+			_queue[_head] = line;
+			_head = (_head + 1) % _capacity;
+			_pending.up();
+		}
+
+		void entry() override
+		{
+			for (;;) {
+				_pending.down();
+
+				Line line;
+				{
+					Lock::Guard guard(_lock);
+					line  = _queue[_tail];
+					_tail = (_tail + 1) % _capacity;
+				}
+
+				/* the potentially slow part, without holding the lock */
+				_log.write(Log_session::String(line.string(), line.length()));
+			}
+		}
+
+	public:
+
+		Sink(Env &env, Allocator &alloc, Xml_node node)
+		:
+			Thread(env, Thread::Name("sink-", node.attribute_value("name", Name())),
+			       STACK_SIZE),
+			_name(node.attribute_value("name", Name())),
+			_log(env, _name.string()),
+			_label       (node.attribute_value("label",        Label())),
+			_label_prefix(node.attribute_value("label_prefix", Label())),
+			_label_suffix(node.attribute_value("label_suffix", Label())),
+			_contains    (node.attribute_value("contains",     Line())),
+			_rate        (node.attribute_value("rate",  0U)),
+			_capacity    (max(2U, node.attribute_value("queue", (unsigned)DEFAULT_QUEUE))),
+			_queue(new (alloc) Line[_capacity])
+		{
+			start();
+		}
+
+		Name const &name() const { return _name; }
+
+		/**
+		 * Queue a client message for this sink
+		 *
+		 * Called from the entrypoint, never blocks on the sink backend.
+		 */
+		void submit(Session_label const &label, char const *prefix,
+		            char const *msg, unsigned long now_ms)
+		{
+			if (!_label_matches(label))
+				return;
+
+			if (_contains.valid() && !_contains_substring(msg, _contains.string()))
+				return;
+
+			if (!_admit(now_ms))
+				return;
+
+			Lock::Guard guard(_lock);
+
+			/* keep counting until the notice fits into the queue */
+			if ((_rate_dropped || _overflow_dropped) && !_full()) {
+				_enqueue(Line("[log_tee] ", _rate_dropped, " rate-limited and ",
+				              _overflow_dropped, " overflowed messages dropped\n"));
+				_rate_dropped = _overflow_dropped = 0;
+			}
+
+			_enqueue(Line(prefix, msg));
+		}
+};
+
+
 class Log_tee::Session_component : public Rpc_object<Log_session>
 {
 	private:
@@ -43,20 +241,47 @@ class Log_tee::Session_component : public Rpc_object<Log_session>
 			{ }
 		} _log;
 
+		Session_label const _label;
+
 		Genode::String<Session_label::capacity()+3> _prefix;
 
+		Sink_list         &_sinks;
+		Timer::Connection *_timer;
+		Capture           *_capture;
+
+		unsigned const _label_id;
+
 	public:
 
-		Session_component(Env &env, Session_label const &label, char const *args)
-		: _log(env, args), _prefix("[", label.string(), "] ") { }
+		Session_component(Env &env, Session_label const &label, char const *args,
+		                  Sink_list &sinks, Timer::Connection *timer,
+		                  Capture *capture)
+		:
+			_log(env, args), _label(label), _prefix("[", label.string(), "] "),
+			_sinks(sinks), _timer(timer), _capture(capture),
+			_label_id(capture ? capture->label_id(label) : 0)
+		{ }
 
 		size_t write(Log_session::String const &msg) override
 		{
 			/* write to the dedicated client log session */
 			size_t n = _log.write(msg);
 
-			/* write to our own log session */
-			log(_prefix, msg.string());
+			if (_capture)
+				_capture->submit(_label_id, msg);
+
+			if (!_sinks.first()) {
+				/* write to our own log session */
+				log(_prefix, msg.string());
+				return n;
+			}
+
+			/* fan out to the configured sinks */
+			unsigned long const now_ms = _timer
+				? _timer->curr_time().trunc_to_plain_ms().value : 0;
+			for (Sink *sink = _sinks.first();
+			     sink; sink = sink->next())
+				sink->submit(_label, _prefix.string(), msg.string(), now_ms);
 
 			return n;
 		}
@@ -70,12 +295,65 @@ class Log_tee::Root_component :
 
 		Env &_env;
 
+		Sink_list _sinks { };
+
+		Constructible<Timer::Connection> _timer { };
+
+		Constructible<Capture> _capture { };
+
 	protected:
 
 		Log_tee::Session_component *_create_session(char const *args) override
 		{
 			Session_label const label = label_from_args(args);
-			return new (md_alloc()) Session_component(_env, label, args);
+			return new (md_alloc())
+				Session_component(_env, label, args, _sinks,
+				                  _timer.constructed()   ? &*_timer   : nullptr,
+				                  _capture.constructed() ? &*_capture : nullptr);
+		}
+
+		Sink *_create_sink(Allocator &alloc, Xml_node node)
+		{
+			Sink::Name const name = node.attribute_value("name", Sink::Name());
+
+			try { return new (alloc) Sink(_env, alloc, node); }
+			catch (Out_of_ram)             { error("sink ", name, ": Out_of_ram"); }
+			catch (Out_of_caps)            { error("sink ", name, ": Out_of_caps"); }
+			catch (Service_denied)         { error("sink ", name, ": Service_denied"); }
+			catch (Insufficient_cap_quota) { error("sink ", name, ": Insufficient_cap_quota"); }
+			catch (Insufficient_ram_quota) { error("sink ", name, ": Insufficient_ram_quota"); }
+			return nullptr;
+		}
+
+		void _configure(Allocator &alloc, Xml_node config)
+		{
+			Sink *last = nullptr;
+			config.for_each_sub_node("sink", [&] (Xml_node node) {
+				if (!node.has_attribute("name")) {
+					error("ignoring sink without 'name' attribute");
+					return;
+				}
+				if (node.attribute_value("rate", 0U) && !_timer.constructed())
+					_timer.construct(_env);
+
+				Sink *sink = _create_sink(alloc, node);
+				if (!sink)
+					return;
+
+				/* preserve configuration order */
+				_sinks.insert(sink, last);
+				last = sink;
+			});
+
+			if (config.has_sub_node("capture")) {
+				if (!_timer.constructed())
+					_timer.construct(_env);
+				try {
+					_capture.construct(_env, alloc, *_timer,
+					                   config.sub_node("capture")); }
+				catch (...) {
+					error("failed to open log capture, capture disabled"); }
+			}
 		}
 
 	public:
@@ -84,7 +362,13 @@ class Log_tee::Root_component :
 		:
 			Genode::Root_component<Log_tee::Session_component>(env.ep(), alloc),
 			_env(env)
-		{ }
+		{
+			/* without config, all messages go to our own log session */
+			try {
+				Attached_rom_dataspace config(env, "config");
+				_configure(alloc, config.xml());
+			} catch (Rom_connection::Rom_connection_failed) { }
+		}
 };
 
 
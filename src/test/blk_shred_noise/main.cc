@@ -0,0 +1,117 @@
+/*
+ * \brief   Micro-benchmark of the blk_shred noise generator
+ * \author  agent
+ * \date    2026-10-16
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU Affero General Public License version 3.
+ */
+
+/* Genode includes */
+#include <timer_session/connection.h>
+#include <base/attached_rom_dataspace.h>
+#include <base/heap.h>
+#include <base/component.h>
+
+/* blk_shred includes */
+#include <noise.h>
+
+namespace Test {
+	using namespace Genode;
+	struct Main;
+}
+
+
+struct Test::Main
+{
+	enum { SEED = 0x853c49e6748fea9bULL, SEQ = 0xda3e39cb94b95bdbULL };
+
+	Genode::Env &env;
+
+	Attached_rom_dataspace config { env, "config" };
+
+	Timer::Connection timer { env };
+
+	Heap heap { env.ram(), env.rm() };
+
+	size_t const buffer_size =
+		config.xml().attribute_value("buffer_size", Number_of_bytes(4 << 20));
+
+	unsigned const rounds =
+		config.xml().attribute_value("rounds", 64U);
+
+	size_t const words = buffer_size / sizeof(uint32_t) & ~(Blk_shred::Noise::LANES - 1UL);
+
+	uint32_t * const buffer = (uint32_t*)heap.alloc(words*sizeof(uint32_t));
+
+	uint64_t now_us() { return timer.curr_time().trunc_to_plain_us().value; }
+
+	template <typename FN>
+	void measure(char const *name, FN const &fn)
+	{
+		uint64_t const start_us = now_us();
+		for (unsigned i = 0; i < rounds; i++)
+			fn();
+		uint64_t const us = max(now_us() - start_us, (uint64_t)1);
+
+		uint64_t const bytes = (uint64_t)words*sizeof(uint32_t)*rounds;
+		uint64_t const mb_s  = bytes / us;
+
+		log(name, ": ", mb_s / 1000, ".", (mb_s % 1000) / 100, (mb_s % 100) / 10,
+		    " GB/s");
+	}
+
+	/**
+	 * Check the lanes against the scalar generator behind a seek
+	 */
+	bool check(Blk_shred::Noise &noise)
+	{
+		enum { POS = Blk_shred::Noise::LANES*1000, CHECK_WORDS = 4096 };
+
+		pcg32_random_t lanes[Blk_shred::Noise::LANES];
+		for (unsigned l = 0; l < Blk_shred::Noise::LANES; l++) {
+			pcg32_srandom_r(&lanes[l], SEED, SEQ + l);
+			pcg32_advance_r(&lanes[l], POS / Blk_shred::Noise::LANES);
+		}
+
+		noise.seek(POS);
+		noise.fill(buffer, CHECK_WORDS);
+
+		for (unsigned i = 0; i < CHECK_WORDS; i++)
+			if (buffer[i] != pcg32_random_r(&lanes[i % Blk_shred::Noise::LANES]))
+				return false;
+		return true;
+	}
+
+	Main(Genode::Env &env) : env(env)
+	{
+		Blk_shred::Noise noise { SEED, SEQ };
+
+		if (!check(noise)) {
+			error("noise lanes differ from the scalar generator");
+			env.parent().exit(-1);
+			return;
+		}
+
+		log("filling ", words*sizeof(uint32_t) >> 10, " KiB ", rounds, " times");
+
+		pcg32_random_t pcg;
+		pcg32_srandom_r(&pcg, SEED, SEQ);
+
+		measure("scalar", [&] () {
+			for (size_t i = 0; i < words; i++)
+				buffer[i] = pcg32_random_r(&pcg); });
+
+		measure("lanes ", [&] () {
+			noise.fill(buffer, words); });
+
+		env.parent().exit(0);
+	}
+};
+
+
+void Component::construct(Genode::Env &env) { static Test::Main main(env); }
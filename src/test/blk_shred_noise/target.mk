@@ -0,0 +1,8 @@
+TARGET  = test-blk_shred_noise
+LIBS    = base libpcg_random
+SRC_CC  = main.cc
+INC_DIR = $(REP_DIR)/src/app/blk_shred
+
+CC_OLEVEL = -O3
+
+CC_CXX_WARN_STRICT =
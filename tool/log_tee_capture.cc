@@ -0,0 +1,185 @@
+/*
+ * \brief  Host tool to decode and merge log_tee captures
+ * \author agent
+ * \date   2026-10-16
+ *
+ * Build with
+ *
+ * ! g++ -std=c++11 -O2 -o log_tee_capture log_tee_capture.cc
+ *
+ * Usage
+ *
+ * ! log_tee_capture [-l <label substring>] [-g] <capture>...
+ *
+ * The messages of all given captures are merged into one timeline ordered
+ * by timestamp. With '-g', gaps in the sequence numbers of a capture,
+ * caused by messages dropped within log_tee, are reported.
+ */
+
+/*
+ * Copyright (C) 2026 Genode Labs GmbH
+ *
+ * This file is part of the Genode OS framework, which is distributed
+ * under the terms of the GNU General Public License version 2.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+/* must match 'Log_tee::Capture' in src/server/log_tee/capture.h */
+struct Header
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t slot_size;
+	uint32_t slot_count;
+	uint32_t label_count;
+	uint32_t label_size;
+	uint32_t reserved;
+	char     origin[32];
+};
+
+struct Slot_header
+{
+	uint64_t timestamp_us;
+	uint64_t seq;
+	uint16_t label_id;
+	uint16_t length;
+	uint32_t reserved;
+};
+
+static_assert(sizeof(Header) == 64,      "unexpected header size");
+static_assert(sizeof(Slot_header) == 24, "unexpected slot header size");
+
+
+struct Message
+{
+	uint64_t    timestamp_us;
+	uint64_t    seq;
+	std::string origin;
+	std::string label;
+	std::string text;
+};
+
+
+static bool load(char const *path, std::string const &label_filter,
+                 bool report_gaps, std::vector<Message> &out)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> const data((std::istreambuf_iterator<char>(file)),
+	                             std::istreambuf_iterator<char>());
+
+	Header header;
+	if (data.size() < sizeof(header)) {
+		fprintf(stderr, "%s: truncated header\n", path);
+		return false;
+	}
+	memcpy(&header, data.data(), sizeof(header));
+
+	if (memcmp(header.magic, "LTEECAP1", sizeof(header.magic)) || header.version != 1) {
+		fprintf(stderr, "%s: not a log_tee capture\n", path);
+		return false;
+	}
+
+	size_t const labels_offset = sizeof(header);
+	size_t const slots_offset  = labels_offset
+	                           + (size_t)header.label_count*header.label_size;
+
+	if (header.slot_size < sizeof(Slot_header)
+	 || data.size() < slots_offset + (size_t)header.slot_count*header.slot_size) {
+		fprintf(stderr, "%s: truncated capture\n", path);
+		return false;
+	}
+
+	std::string const origin(header.origin, strnlen(header.origin, sizeof(header.origin)));
+
+	std::vector<std::string> labels;
+	for (uint32_t i = 0; i < header.label_count; ++i) {
+		char const *s = data.data() + labels_offset + (size_t)i*header.label_size;
+		labels.emplace_back(s, strnlen(s, header.label_size));
+	}
+
+	std::vector<uint64_t> seqs;
+
+	for (uint32_t i = 0; i < header.slot_count; ++i) {
+		char const *slot = data.data() + slots_offset + (size_t)i*header.slot_size;
+
+		Slot_header sh;
+		memcpy(&sh, slot, sizeof(sh));
+		if (!sh.seq)
+			continue;
+
+		seqs.push_back(sh.seq);
+
+		size_t const max_len = header.slot_size - sizeof(sh);
+		std::string const label = sh.label_id < labels.size()
+		                        ? labels[sh.label_id] : std::string("?");
+
+		if (!label_filter.empty() && label.find(label_filter) == std::string::npos)
+			continue;
+
+		std::string text(slot + sizeof(sh), std::min<size_t>(sh.length, max_len));
+		while (!text.empty() && text.back() == '\n')
+			text.pop_back();
+
+		out.push_back(Message { sh.timestamp_us, sh.seq, origin, label, text });
+	}
+
+	if (report_gaps && !seqs.empty()) {
+		std::sort(seqs.begin(), seqs.end());
+		for (size_t i = 1; i < seqs.size(); ++i)
+			if (seqs[i] != seqs[i-1] + 1)
+				fprintf(stderr, "%s: %llu messages dropped after seq %llu\n",
+				        path, (unsigned long long)(seqs[i] - seqs[i-1] - 1),
+				        (unsigned long long)seqs[i-1]);
+	}
+
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	std::string label_filter;
+	bool report_gaps = false;
+	std::vector<char const *> paths;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-l") && i + 1 < argc)
+			label_filter = argv[++i];
+		else if (!strcmp(argv[i], "-g"))
+			report_gaps = true;
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.empty()) {
+		fprintf(stderr, "usage: %s [-l <label substring>] [-g] <capture>...\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<Message> messages;
+	for (char const *path : paths)
+		if (!load(path, label_filter, report_gaps, messages))
+			return 1;
+
+	std::stable_sort(messages.begin(), messages.end(),
+		[] (Message const &a, Message const &b) {
+			if (a.timestamp_us != b.timestamp_us)
+				return a.timestamp_us < b.timestamp_us;
+			return a.seq < b.seq; });
+
+	for (Message const &m : messages)
+		printf("%llu.%06llu %s [%s] %s\n",
+		       (unsigned long long)(m.timestamp_us / 1000000),
+		       (unsigned long long)(m.timestamp_us % 1000000),
+		       m.origin.c_str(), m.label.c_str(), m.text.c_str());
+
+	return 0;
+}